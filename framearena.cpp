@@ -0,0 +1,50 @@
+#include "framearena.h"
+
+FrameArena::FrameArena(size_t blockBytes) : m_blockBytes(blockBytes) {
+    m_blocks.reserve(8);
+}
+
+size_t FrameArena::capacity() const {
+    size_t total = 0;
+    for (const auto& b : m_blocks) total += b.size;
+    return total;
+}
+
+void FrameArena::addBlock(size_t minBytes) {
+    Block b;
+    b.size = minBytes > m_blockBytes ? minBytes : m_blockBytes;
+    b.data.reset(new char[b.size]);
+    m_blocks.push_back(std::move(b));
+    ++m_heapAllocs;
+}
+
+void* FrameArena::allocBytes(size_t bytes, size_t align) {
+    if (bytes == 0) bytes = 1;
+
+    if (m_blocks.empty()) addBlock(bytes + align);
+
+    for (;;) {
+        Block& b = m_blocks[m_current];
+        const size_t start = (m_offset + align - 1) / align * align;
+        if (start + bytes <= b.size) {
+            m_used += start + bytes - m_offset;
+            m_offset = start + bytes;
+            return b.data.get() + start;
+        }
+        if (m_current + 1 == m_blocks.size()) addBlock(bytes + align);
+        ++m_current;
+        m_offset = 0;
+    }
+}
+
+void FrameArena::reset() {
+    if (m_blocks.size() > 1) {
+        // Next frame gets one block that fits everything this frame needed.
+        const size_t total = capacity();
+        m_blocks.clear();
+        addBlock(total);
+    }
+    m_current = 0;
+    m_offset = 0;
+    m_used = 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <type_traits>
+
+// Bump allocator for transient per-frame geometry.
+// Memory handed out is valid until the next reset(). When a frame spills into extra
+// blocks, reset() folds them into one block big enough for that frame, so a warmed-up
+// arena stops touching the heap.
+class FrameArena {
+public:
+    explicit FrameArena(size_t blockBytes = 64 * 1024);
+
+    template <class T>
+    T* alloc(size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "FrameArena only holds POD data");
+        return static_cast<T*>(allocBytes(count * sizeof(T), alignof(T)));
+    }
+
+    void* allocBytes(size_t bytes, size_t align);
+    void reset();
+
+    size_t bytesUsed() const { return m_used; }
+    size_t capacity() const;
+    // Heap allocations made by the arena since construction.
+    int heapAllocations() const { return m_heapAllocs; }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+    };
+
+    void addBlock(size_t minBytes);
+
+    std::vector<Block> m_blocks;
+    size_t m_current = 0;   // index into m_blocks
+    size_t m_offset = 0;    // bump offset inside the current block
+    size_t m_used = 0;      // bytes handed out this frame (incl. padding)
+    size_t m_blockBytes;
+    int m_heapAllocs = 0;
+};
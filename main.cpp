@@ -4,6 +4,7 @@
 #include <QSGRendererInterface>
 #include <QtQml>
 
+#include "spinedirectviewport.h"
 #include "spineviewport.h"
 
 int main(int argc, char *argv[])
@@ -14,6 +15,7 @@ int main(int argc, char *argv[])
     QGuiApplication app(argc, argv);
 
     qmlRegisterType<SpineViewport>("MySpine", 1, 0, "SpineViewport");
+    qmlRegisterType<SpineDirectViewport>("MySpine", 1, 0, "SpineDirectViewport");
 
     QQmlApplicationEngine engine;
     engine.load(QUrl(QStringLiteral("qrc:/qml/main.qml")));
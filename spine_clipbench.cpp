@@ -0,0 +1,148 @@
+// CPU cost of the two clipping modes: spSkeletonClipping vs stencil batches.
+//
+//   SgsSpineClipBench <file.atlas> <file.skel> [animation] [iterations]
+//
+// Steps the animation (first one if none is given) through one second at 60 Hz and
+// builds a draw list for every pose in both modes; times cover build() only. The GPU
+// side of the stencil mode (two extra fan draws per clip range) is not measured here.
+// No GL context is needed: page uploads are only queued and are dropped on dispose.
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "framearena.h"
+#include "spinedrawlist.h"
+
+namespace {
+const int kPoses = 60;
+const float kStep = 1.f / 60.f;
+
+struct Timing {
+    double minMs = 0.0;
+    double medianMs = 0.0;
+    double meanMs = 0.0;
+};
+
+struct Totals {
+    int vertices = 0;
+    int indices = 0;
+    int drawBatches = 0;
+    int clipBatches = 0;
+    int clips = 0;
+};
+
+struct Run {
+    Timing timing;
+    Totals totals;
+};
+
+// Builds every pose once per iteration; totals are from the last iteration.
+Run measure(spSkeleton* skeleton, spAnimation* animation, bool stencil, int iterations) {
+    spSkeletonClipping* clipper = spSkeletonClipping_create();
+    FrameArena arena;
+    SpineDrawList list;
+    list.stencilClipping = stencil;
+
+    Run run;
+    std::vector<double> ms;
+    ms.reserve((size_t)iterations);
+    for (int i = 0; i < iterations; ++i) {
+        run.totals = Totals{};
+        qint64 ns = 0;
+        for (int p = 0; p < kPoses; ++p) {
+            spSkeleton_setToSetupPose(skeleton);
+            spAnimation_apply(animation, skeleton, 0.f, p * kStep, 1, nullptr, nullptr, 1.f, SP_MIX_POSE_SETUP, SP_MIX_DIRECTION_IN);
+            spSkeleton_updateWorldTransform(skeleton);
+            arena.reset();
+
+            QElapsedTimer clock;
+            clock.start();
+            list.build(skeleton, clipper, arena);
+            ns += clock.nsecsElapsed();
+
+            run.totals.vertices += list.vertexCount();
+            run.totals.indices += list.indexCount();
+            for (const auto& batch : list.batches)
+                ++(batch.kind == SpineDrawList::Draw ? run.totals.drawBatches : run.totals.clipBatches);
+            run.totals.clips += list.stencilClips;
+        }
+        ms.push_back(double(ns) / 1e6);
+    }
+    spSkeletonClipping_dispose(clipper);
+
+    std::sort(ms.begin(), ms.end());
+    run.timing.minMs = ms.front();
+    run.timing.medianMs = ms[ms.size() / 2];
+    for (double v : ms) run.timing.meanMs += v;
+    run.timing.meanMs /= double(ms.size());
+    return run;
+}
+
+void print(const char* label, const Run& r) {
+    std::printf("%-8s min %8.3f ms   median %8.3f ms   mean %8.3f ms   verts %8d   indices %8d   draws %6d   clip draws %5d   stencil clips %4d\n",
+                label, r.timing.minMs, r.timing.medianMs, r.timing.meanMs,
+                r.totals.vertices, r.totals.indices, r.totals.drawBatches, r.totals.clipBatches, r.totals.clips);
+}
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    if (args.size() < 3) {
+        std::fprintf(stderr, "usage: %s <file.atlas> <file.skel> [animation] [iterations]\n", argv[0]);
+        return 2;
+    }
+    const QByteArray atlasPath = args[1].toUtf8();
+    const QByteArray skelPath = args[2].toUtf8();
+    const QByteArray animationName = args.size() > 3 ? args[3].toUtf8() : QByteArray();
+    const int iterations = args.size() > 4 ? qMax(1, args[4].toInt()) : 20;
+
+    spAtlas* atlas = spAtlas_createFromFile(atlasPath.constData(), nullptr);
+    if (!atlas) {
+        std::fprintf(stderr, "cannot load atlas %s\n", atlasPath.constData());
+        return 1;
+    }
+
+    spSkeletonBinary* binary = spSkeletonBinary_create(atlas);
+    spSkeletonData* data = spSkeletonBinary_readSkeletonDataFile(binary, skelPath.constData());
+    spSkeletonBinary_dispose(binary);
+    if (!data || data->animationsCount == 0) {
+        std::fprintf(stderr, "cannot load skeleton %s (or it has no animations)\n", skelPath.constData());
+        if (data) spSkeletonData_dispose(data);
+        spAtlas_dispose(atlas);
+        return 1;
+    }
+
+    spAnimation* animation = animationName.isEmpty()
+        ? data->animations[0]
+        : spSkeletonData_findAnimation(data, animationName.constData());
+    if (!animation) {
+        std::fprintf(stderr, "no animation %s\n", animationName.constData());
+        spSkeletonData_dispose(data);
+        spAtlas_dispose(atlas);
+        return 1;
+    }
+
+    spSkeleton* skeleton = spSkeleton_create(data);
+    const Run cpu = measure(skeleton, animation, false, iterations);
+    const Run stencil = measure(skeleton, animation, true, iterations);
+
+    std::printf("atlas %s, skel %s, animation %s, %d poses x %d iterations\n",
+                atlasPath.constData(), skelPath.constData(), animation->name, kPoses, iterations);
+    print("cpu", cpu);
+    print("stencil", stencil);
+    if (stencil.timing.medianMs > 0.0)
+        std::printf("speedup  %.2fx (median build)\n", cpu.timing.medianMs / stencil.timing.medianMs);
+    if (stencil.totals.clips == 0)
+        std::printf("note: no clipping attachment was active in these poses\n");
+
+    spSkeleton_dispose(skeleton);
+    spSkeletonData_dispose(data);
+    spAtlas_dispose(atlas);
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Microbenchmark for SpineVertexKernels: every kernel table this CPU supports against
+// the scalar reference, on meshes of 4 to 4096 vertices.
+//
+//   SgsSpineKernelBench [iterations]
+//
+// Each table is first checked for bit-exact output against the scalar one (non-zero
+// exit on mismatch), also at odd sizes that end in the scalar tail of the SIMD loops. Times are per mesh, best of the iterations; "fused" is the
+// transform + interleave pass the draw list uses for unweighted meshes, "split" the
+// same work as two passes through an xy scratch buffer.
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "spinevertexkernels.h"
+
+namespace {
+const float kMatrix[6] = {0.8f, -0.6f, 0.6f, 0.8f, 120.f, -40.f};
+const float kColor[4] = {1.f, 0.5f, 0.25f, 1.f};
+
+struct Mesh {
+    std::vector<float> local;
+    std::vector<float> uv;
+    int count = 0;
+};
+
+Mesh makeMesh(int count, std::mt19937& rng) {
+    std::uniform_real_distribution<float> pos(-256.f, 256.f);
+    std::uniform_real_distribution<float> tex(0.f, 1.f);
+    Mesh mesh;
+    mesh.count = count;
+    mesh.local.resize(size_t(count) * 2);
+    mesh.uv.resize(size_t(count) * 2);
+    for (float& v : mesh.local) v = pos(rng);
+    for (float& v : mesh.uv) v = tex(rng);
+    return mesh;
+}
+
+void resetBox(float* box) {
+    box[0] = box[1] = std::numeric_limits<float>::infinity();
+    box[2] = box[3] = -std::numeric_limits<float>::infinity();
+}
+
+bool matchesScalar(const SpineVertexKernels::Table& k, const Mesh& mesh) {
+    const SpineVertexKernels::Table& ref = SpineVertexKernels::scalar();
+    const size_t n = size_t(mesh.count);
+    std::vector<float> xyA(n * 2), xyB(n * 2), vA(n * 8), vB(n * 8);
+    float boxA[4], boxB[4];
+
+    resetBox(boxA);
+    resetBox(boxB);
+    ref.transform(mesh.local.data(), mesh.count, kMatrix, xyA.data(), boxA);
+    k.transform(mesh.local.data(), mesh.count, kMatrix, xyB.data(), boxB);
+    if (xyA != xyB || std::memcmp(boxA, boxB, sizeof boxA) != 0) return false;
+
+    ref.interleave(xyA.data(), mesh.uv.data(), mesh.count, kColor, vA.data());
+    k.interleave(xyA.data(), mesh.uv.data(), mesh.count, kColor, vB.data());
+    if (vA != vB) return false;
+
+    resetBox(boxB);
+    k.transformInterleave(mesh.local.data(), mesh.uv.data(), mesh.count, kMatrix, kColor, vB.data(), boxB);
+    return vA == vB && std::memcmp(boxA, boxB, sizeof boxA) == 0;
+}
+
+// Best time per call in nanoseconds; each sample repeats the call enough to be measurable.
+double bestNs(int iterations, int repeat, const std::function<void()>& run) {
+    double best = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < iterations; ++i) {
+        QElapsedTimer clock;
+        clock.start();
+        for (int r = 0; r < repeat; ++r) run();
+        best = std::min(best, double(clock.nsecsElapsed()) / repeat);
+    }
+    return best;
+}
+}
+
+int main(int argc, char* argv[]) {
+    const int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 50;
+    const int sizes[] = {4, 16, 64, 256, 1024, 4096};
+    // 1..7 and 4097 leave 1 to 7 vertices for the scalar tail, whose bounds are merged
+    // into the SIMD lanes' box.
+    const int checkSizes[] = {1, 3, 5, 7, 4097};
+
+    std::mt19937 rng(1234);
+    std::vector<Mesh> meshes;
+    for (int n : sizes) meshes.push_back(makeMesh(n, rng));
+    std::vector<Mesh> checked = meshes;
+    for (int n : checkSizes) checked.push_back(makeMesh(n, rng));
+
+    std::vector<const SpineVertexKernels::Table*> tables;
+    for (int isa = 0; isa < SpineVertexKernels::IsaCount; ++isa) {
+        if (SpineVertexKernels::supported(SpineVertexKernels::Isa(isa)))
+            tables.push_back(&SpineVertexKernels::table(SpineVertexKernels::Isa(isa)));
+    }
+
+    bool ok = true;
+    for (const auto* k : tables) {
+        for (const Mesh& mesh : checked) {
+            if (!matchesScalar(*k, mesh)) {
+                std::printf("MISMATCH: %s differs from scalar at %d vertices\n", k->name, mesh.count);
+                ok = false;
+            }
+        }
+    }
+
+    std::printf("active kernels: %s, %d iterations, ns per mesh (speedup vs scalar)\n",
+                SpineVertexKernels::active().name, iterations);
+    std::printf("%-7s %6s %18s %18s %18s %18s\n", "isa", "verts", "transform", "interleave", "split", "fused");
+
+    for (const Mesh& mesh : meshes) {
+        const size_t n = size_t(mesh.count);
+        std::vector<float> xy(n * 2), out(n * 8);
+        float box[4];
+        const int repeat = std::max(1, 65536 / mesh.count);
+
+        double scalarNs[4] = {};
+        for (const auto* k : tables) {
+            const double ns[4] = {
+                bestNs(iterations, repeat, [&] {
+                    resetBox(box);
+                    k->transform(mesh.local.data(), mesh.count, kMatrix, xy.data(), box);
+                }),
+                bestNs(iterations, repeat, [&] {
+                    k->interleave(xy.data(), mesh.uv.data(), mesh.count, kColor, out.data());
+                }),
+                bestNs(iterations, repeat, [&] {
+                    resetBox(box);
+                    k->transform(mesh.local.data(), mesh.count, kMatrix, xy.data(), box);
+                    k->interleave(xy.data(), mesh.uv.data(), mesh.count, kColor, out.data());
+                }),
+                bestNs(iterations, repeat, [&] {
+                    resetBox(box);
+                    k->transformInterleave(mesh.local.data(), mesh.uv.data(), mesh.count, kMatrix, kColor,
+                                           out.data(), box);
+                }),
+            };
+            if (k->isa == SpineVertexKernels::Scalar) std::copy(ns, ns + 4, scalarNs);
+
+            std::printf("%-7s %6d", k->name, mesh.count);
+            for (int i = 0; i < 4; ++i) std::printf(" %10.1f (%4.2fx)", ns[i], scalarNs[i] / ns[i]);
+            std::printf("\n");
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+// Cold-start comparison: spine-c atlas parse + PNG decode vs the SpineFastCache file.
+//
+//   SgsSpineLoadBench <file.atlas> <file.skel> [iterations]
+//
+// Both paths also parse the .skel (from a mapping), since that is the rest of a unit's
+// startup cost. Uses SGS_SPINE_CACHE_DIR if set, otherwise a temp directory.
+// No GL context is needed: page uploads are only queued and are dropped on dispose.
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "spineassetcache.h"
+#include "spinefastcache.h"
+#include "spinemappedfile.h"
+
+namespace {
+struct Timing {
+    double minMs = 0.0;
+    double medianMs = 0.0;
+    double meanMs = 0.0;
+};
+
+Timing measure(int iterations, const std::function<bool()>& run) {
+    std::vector<double> ms;
+    ms.reserve((size_t)iterations);
+    for (int i = 0; i < iterations; ++i) {
+        QElapsedTimer clock;
+        clock.start();
+        if (!run()) return Timing{};
+        ms.push_back(double(clock.nsecsElapsed()) / 1e6);
+    }
+    std::sort(ms.begin(), ms.end());
+    Timing t;
+    t.minMs = ms.front();
+    t.medianMs = ms[ms.size() / 2];
+    for (double v : ms) t.meanMs += v;
+    t.meanMs /= double(ms.size());
+    return t;
+}
+
+bool parseSkeleton(spAtlas* atlas, const QString& skelPath) {
+    SpineMappedFile file(skelPath);
+    if (!file.isOpen()) return false;
+    spSkeletonBinary* binary = spSkeletonBinary_create(atlas);
+    spSkeletonData* data = spSkeletonBinary_readSkeletonData(
+        binary, reinterpret_cast<const unsigned char*>(file.data()), file.size());
+    spSkeletonBinary_dispose(binary);
+    if (!data) return false;
+    spSkeletonData_dispose(data);
+    return true;
+}
+
+void print(const char* label, const Timing& t) {
+    std::printf("%-12s min %8.2f ms   median %8.2f ms   mean %8.2f ms\n",
+                label, t.minMs, t.medianMs, t.meanMs);
+}
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    if (args.size() < 3) {
+        std::fprintf(stderr, "usage: %s <file.atlas> <file.skel> [iterations]\n", argv[0]);
+        return 2;
+    }
+    const QString atlasPath = args[1];
+    const QString skelPath = args[2];
+    const int iterations = args.size() > 3 ? qMax(1, args[3].toInt()) : 20;
+
+    if (!SpineFastCache::enabled())
+        qputenv("SGS_SPINE_CACHE_DIR", QDir(QDir::tempPath()).filePath("sgs-spine-cache").toUtf8());
+
+    const QByteArray atlasUtf8 = atlasPath.toUtf8();
+    const QByteArray dir = SpineFastCache::pageDir(atlasPath);
+
+    // Baseline, and the first-run step that writes the cache file.
+    spAtlas* seed = spAtlas_createFromFile(atlasUtf8.constData(), nullptr);
+    if (!seed) {
+        std::fprintf(stderr, "cannot load atlas %s\n", atlasUtf8.constData());
+        return 1;
+    }
+    QElapsedTimer storeClock;
+    storeClock.start();
+    const bool stored = SpineFastCache::store(atlasPath, dir, seed);
+    const double storeMs = double(storeClock.nsecsElapsed()) / 1e6;
+    spAtlas_dispose(seed);
+    if (!stored) {
+        std::fprintf(stderr, "cannot write cache under %s\n", qPrintable(SpineFastCache::cacheDir()));
+        return 1;
+    }
+
+    const Timing spine = measure(iterations, [&] {
+        spAtlas* atlas = spAtlas_createFromFile(atlasUtf8.constData(), nullptr);
+        if (!atlas) return false;
+        const bool ok = parseSkeleton(atlas, skelPath);
+        spAtlas_dispose(atlas);
+        return ok;
+    });
+
+    const Timing fast = measure(iterations, [&] {
+        spAtlas* atlas = SpineFastCache::load(atlasPath, dir);
+        if (!atlas) return false;
+        const bool ok = parseSkeleton(atlas, skelPath);
+        spAtlas_dispose(atlas);
+        return ok;
+    });
+
+    std::printf("atlas %s, skel %s, %d iterations\n", atlasUtf8.constData(), qPrintable(skelPath), iterations);
+    std::printf("cache file  %s (written in %.2f ms)\n", qPrintable(SpineFastCache::cacheFile(atlasPath)), storeMs);
+    print("spine-c", spine);
+    print("fast cache", fast);
+    if (fast.medianMs > 0.0) std::printf("speedup     %.2fx (median)\n", spine.medianMs / fast.medianMs);
+    return (spine.medianMs > 0.0 && fast.medianMs > 0.0) ? 0 : 1;
+}
@@ -1,10 +1,12 @@
 #include <QImage>
 #include <QOpenGLTexture>
-#include <QFile>
-#include <QByteArray>
 #include <QString>
 #include <QDebug>
 
+#include "spineassetcache.h"
+#include "spinemappedfile.h"
+#include "spinetexturepool.h"
+
 #ifdef slots
 #  undef slots
 #endif
@@ -20,27 +22,28 @@ extern "C" {
 #include <spine/extension.h>
 }
 
+// spine-c frees the result, so one copy is unavoidable; it is taken straight from the
+// mapping instead of going through a QByteArray first.
 extern "C" char* _spUtil_readFile(const char* path, int* length) {
-    QFile f(QString::fromUtf8(path));
-    if (!f.exists()) f.setFileName("assets/" + QString::fromUtf8(path));
-    if (!f.open(QIODevice::ReadOnly)) {
+    SpineMappedFile file(QString::fromUtf8(path));
+    if (!file.isOpen()) {
         if (length) *length = 0;
         return nullptr;
     }
-    QByteArray data = f.readAll();
-    f.close();
 
-    char* buf = (char*)malloc((size_t)data.size() + 1);
+    char* buf = (char*)malloc((size_t)file.size() + 1);
     if (!buf) {
         if (length) *length = 0;
         return nullptr;
     }
-    memcpy(buf, data.constData(), (size_t)data.size());
-    buf[data.size()] = '\0';
-    if (length) *length = data.size();
+    memcpy(buf, file.data(), (size_t)file.size());
+    buf[file.size()] = '\0';
+    if (length) *length = file.size();
     return buf;
 }
 
+// Runs on asset loader threads: decode only. The page's GL texture (or texture pool
+// layer) is made and filled later by SpineAssetCache::processUploads on the render thread.
 extern "C" void _spAtlasPage_createTexture(spAtlasPage* page, const char* path) {
     QImage img(QString::fromUtf8(path));
     if (img.isNull()) img = QImage("assets/" + QString::fromUtf8(path));
@@ -53,16 +56,20 @@ extern "C" void _spAtlasPage_createTexture(spAtlasPage* page, const char* path)
 
     img = img.convertToFormat(QImage::Format_RGBA8888);
 
-    auto* tex = new QOpenGLTexture(img);
-    tex->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
-    tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+    page->rendererObject = new SpinePageTexture;
+    page->width = img.width();
+    page->height = img.height();
 
-    page->rendererObject = tex;
-    page->width = tex->width();
-    page->height = tex->height();
+    SpineAssetCache::instance().queueUpload(page, img);
 }
 
 extern "C" void _spAtlasPage_disposeTexture(spAtlasPage* page) {
-    delete static_cast<QOpenGLTexture*>(page->rendererObject);
+    SpineAssetCache::instance().cancelUpload(page);
+    auto* texture = static_cast<SpinePageTexture*>(page->rendererObject);
+    if (texture) {
+        SpineTexturePool::release(texture);
+        delete texture->texture;
+        delete texture;
+    }
     page->rendererObject = nullptr;
 }
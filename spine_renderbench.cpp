@@ -0,0 +1,343 @@
+// Headless benchmark of the whole render pipeline: SpineRenderer on an offscreen
+// surface + FBO, stepped and drawn frame by frame, results as JSON.
+//
+//   SgsSpineRenderBench --atlas <file.atlas> --skel <file.skel> [options]
+//   SgsSpineRenderBench --units <units.json> [options]
+//
+// units.json is an array of unit objects with the same keys as SpineViewport.units
+// (name, atlas, skel, scale, x, y, defaultAnim, clip). --count repeats the list up to
+// that many units laid out on a grid over the viewport. Time advances by a fixed --dt
+// per frame on the calling thread, so runs are repeatable; each frame ends with
+// glFinish() and the wait is reported as the "gpu" phase. With QT_QPA_PLATFORM=offscreen
+// and Mesa (llvmpipe) it runs without a display.
+//
+// --lod forces every unit to one level of detail (default: auto, from the units' own
+// "lod" sizes); --lod all repeats warmup and measurement at each level in turn and
+// reports them under "lods".
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QSurfaceFormat>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "spineassetcache.h"
+#include "spinerenderer.h"
+
+namespace {
+// Per-frame samples of one phase, in ms.
+struct Series {
+    const char* name;
+    std::vector<double> ms;
+};
+
+QJsonObject percentiles(std::vector<double> v) {
+    if (v.empty()) return QJsonObject();
+    std::sort(v.begin(), v.end());
+    auto at = [&v](double p) { return v[std::min(v.size() - 1, size_t(p * double(v.size())))]; };
+    double sum = 0.0;
+    for (double x : v) sum += x;
+    QJsonObject o;
+    o.insert("p50", at(0.50));
+    o.insert("p90", at(0.90));
+    o.insert("p95", at(0.95));
+    o.insert("p99", at(0.99));
+    o.insert("min", v.front());
+    o.insert("max", v.back());
+    o.insert("mean", sum / double(v.size()));
+    return o;
+}
+
+QJsonObject meanMax(const std::vector<double>& v) {
+    if (v.empty()) return QJsonObject();
+    double sum = 0.0;
+    for (double x : v) sum += x;
+    QJsonObject o;
+    o.insert("mean", sum / double(v.size()));
+    o.insert("max", *std::max_element(v.begin(), v.end()));
+    return o;
+}
+
+QVariantList loadUnits(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return QVariantList();
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    return doc.isArray() ? doc.array().toVariantList() : QVariantList();
+}
+
+// Repeats templates up to count units on a grid centred on the view.
+QVariantList layoutUnits(const QVariantList& templates, int count, const QSize& size) {
+    QVariantList units;
+    const int cols = int(std::ceil(std::sqrt(double(count))));
+    const int rows = (count + cols - 1) / cols;
+    for (int i = 0; i < count; ++i) {
+        QVariantMap m = templates[i % templates.size()].toMap();
+        m.insert("name", QStringLiteral("%1#%2").arg(m.value("name").toString()).arg(i));
+        m.insert("x", ((i % cols) + 0.5) * size.width() / cols - size.width() * 0.5);
+        m.insert("y", ((i / cols) + 0.5) * size.height() / rows - size.height() * 0.5);
+        units.push_back(m);
+    }
+    return units;
+}
+}
+
+int main(int argc, char* argv[]) {
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless SpineRenderer benchmark");
+    parser.addHelpOption();
+    const QCommandLineOption unitsOpt("units", "JSON array of unit configs.", "file");
+    const QCommandLineOption atlasOpt("atlas", "Atlas of a single unit template.", "file");
+    const QCommandLineOption skelOpt("skel", "Skeleton of a single unit template.", "file");
+    const QCommandLineOption scaleOpt("scale", "Scale of the single unit template.", "scale", "1");
+    const QCommandLineOption countOpt("count", "Repeat the units up to this many, on a grid.", "n");
+    const QCommandLineOption animOpt("animation", "Looping animation for every unit (overrides defaultAnim).", "name");
+    const QCommandLineOption framesOpt("frames", "Measured frames.", "n", "300");
+    const QCommandLineOption warmupOpt("warmup", "Unmeasured frames after loading.", "n", "60");
+    const QCommandLineOption dtOpt("dt", "Simulated seconds per frame.", "seconds", "0.0166667");
+    const QCommandLineOption sizeOpt("size", "FBO size.", "WxH", "1280x720");
+    const QCommandLineOption threadsOpt("threads", "Sim update threads (0 = one per core).", "n", "1");
+    const QCommandLineOption formatOpt("format", "Vertex format: float, packed or batch.", "format", "float");
+    const QCommandLineOption skinOpt("gpu-skinning", "Skin weighted meshes in the vertex shader.");
+    const QCommandLineOption lodOpt("lod", "Level of detail: auto, 0, 1, 2 or all.", "level", "auto");
+    const QCommandLineOption labelOpt("label", "Free text stored in the result (e.g. a commit id).", "text");
+    const QCommandLineOption outputOpt("output", "Write the JSON here instead of stdout.", "file");
+    parser.addOptions({unitsOpt, atlasOpt, skelOpt, scaleOpt, countOpt, animOpt, framesOpt, warmupOpt, dtOpt,
+                       sizeOpt, threadsOpt, formatOpt, skinOpt, lodOpt, labelOpt, outputOpt});
+    parser.process(app);
+
+    QVariantList units;
+    if (parser.isSet(unitsOpt)) {
+        units = loadUnits(parser.value(unitsOpt));
+    } else if (parser.isSet(atlasOpt) && parser.isSet(skelOpt)) {
+        QVariantMap m;
+        m.insert("name", "unit");
+        m.insert("atlas", parser.value(atlasOpt));
+        m.insert("skel", parser.value(skelOpt));
+        m.insert("scale", parser.value(scaleOpt).toDouble());
+        units.push_back(m);
+    }
+    if (units.isEmpty()) {
+        std::fprintf(stderr, "no units: pass --units <file.json> or --atlas and --skel\n");
+        return 2;
+    }
+
+    const QStringList sizeParts = parser.value(sizeOpt).split('x');
+    const QSize size = sizeParts.size() == 2 ? QSize(sizeParts[0].toInt(), sizeParts[1].toInt()) : QSize();
+    if (size.isEmpty()) {
+        std::fprintf(stderr, "bad --size %s\n", qPrintable(parser.value(sizeOpt)));
+        return 2;
+    }
+    if (parser.isSet(countOpt)) units = layoutUnits(units, qMax(1, parser.value(countOpt).toInt()), size);
+    if (parser.isSet(animOpt)) {
+        for (QVariant& u : units) {
+            QVariantMap m = u.toMap();
+            m.insert("defaultAnim", parser.value(animOpt));
+            u = m;
+        }
+    }
+
+    const QString formatName = parser.value(formatOpt);
+    SpineDrawList::VertexFormat format = SpineDrawList::FloatVertex;
+    if (formatName == "packed") format = SpineDrawList::PackedVertex;
+    else if (formatName == "batch") format = SpineDrawList::BatchColorVertex;
+    else if (formatName != "float") {
+        std::fprintf(stderr, "bad --format %s\n", qPrintable(formatName));
+        return 2;
+    }
+
+    // -1 = auto; kLevels = every level in turn.
+    const QString lodName = parser.value(lodOpt);
+    int lodMode = -1;
+    if (lodName == "all") {
+        lodMode = SpineLod::kLevels;
+    } else if (lodName != "auto") {
+        bool ok = false;
+        lodMode = lodName.toInt(&ok);
+        if (!ok || lodMode < 0 || lodMode >= SpineLod::kLevels) {
+            std::fprintf(stderr, "bad --lod %s\n", qPrintable(lodName));
+            return 2;
+        }
+    }
+
+    const int frames = qMax(1, parser.value(framesOpt).toInt());
+    const int warmup = qMax(0, parser.value(warmupOpt).toInt());
+    const float dt = parser.value(dtOpt).toFloat();
+
+    // Same GL the Qt Quick scene graph gets; the stencil is needed by clip: "stencil".
+    QSurfaceFormat surfaceFormat;
+    surfaceFormat.setVersion(3, 3);
+    surfaceFormat.setProfile(QSurfaceFormat::CoreProfile);
+    surfaceFormat.setDepthBufferSize(24);
+    surfaceFormat.setStencilBufferSize(8);
+
+    QOffscreenSurface surface;
+    surface.setFormat(surfaceFormat);
+    surface.create();
+    QOpenGLContext context;
+    context.setFormat(surfaceFormat);
+    if (!context.create() || !context.makeCurrent(&surface)) {
+        std::fprintf(stderr, "cannot create a GL 3.3 core context\n");
+        return 1;
+    }
+    QOpenGLFunctions* gl = context.functions();
+
+    QJsonObject result;
+    {
+        auto renderer = std::make_unique<SpineRenderer>(units);
+        SpineSimulation& sim = renderer->simulation();
+        sim.setThreadCount(parser.value(threadsOpt).toInt());
+        sim.setVertexFormat(format);
+        sim.setGpuSkinning(parser.isSet(skinOpt));
+
+        std::unique_ptr<QOpenGLFramebufferObject> fbo(renderer->createFramebufferObject(size));
+        fbo->bind();
+
+        // Loading: units join once Ready; every atlas page has to reach GL too.
+        QElapsedTimer loadClock;
+        loadClock.start();
+        for (;;) {
+            sim.step(0.f);
+            renderer->render();
+            bool loading = SpineAssetCache::instance().stats().pendingUploads > 0;
+            for (const auto& info : sim.loadInfo())
+                loading = loading || info.state == SpineSkeletonAsset::Loading || info.state == SpineSkeletonAsset::Uploading;
+            if (!loading) break;
+            if (loadClock.elapsed() > 120000) {
+                std::fprintf(stderr, "units still loading after 120 s\n");
+                return 1;
+            }
+            QThread::msleep(1);
+        }
+        const double loadMs = double(loadClock.nsecsElapsed()) / 1e6;
+
+        int readyUnits = 0;
+        for (const auto& info : sim.loadInfo()) readyUnits += info.state == SpineSkeletonAsset::Ready ? 1 : 0;
+
+        // Warmup + measured frames at the simulation's current level of detail.
+        auto measure = [&] {
+            for (int f = 0; f < warmup; ++f) {
+                sim.step(dt);
+                renderer->render();
+            }
+            gl->glFinish();
+
+            Series phases[] = {
+                {"animation", {}}, {"worldTransform", {}}, {"clipping", {}}, {"vertexBuild", {}},
+                {"upload", {}}, {"drawSubmission", {}}, {"gpu", {}}, {"frame", {}},
+            };
+            std::vector<double> drawCalls, vertices, indices, uploadBytes, lodUnits, lodSkippedSlots, untextured;
+            for (Series& p : phases) p.ms.reserve(size_t(frames));
+
+            for (int f = 0; f < frames; ++f) {
+                QElapsedTimer clock;
+                clock.start();
+                sim.step(dt);
+                renderer->render();
+                const qint64 cpuNs = clock.nsecsElapsed();
+                gl->glFinish();
+                const qint64 frameNs = clock.nsecsElapsed();
+
+                const SpineRenderer::FrameStats& s = renderer->lastFrameStats();
+                const qint64 ns[] = {s.animateNs, s.worldNs, s.clipNs, s.buildNs - s.clipNs,
+                                     s.uploadNs, s.submitNs, frameNs - cpuNs, frameNs};
+                for (size_t i = 0; i < std::size(phases); ++i) phases[i].ms.push_back(double(ns[i]) / 1e6);
+                drawCalls.push_back(s.drawCalls);
+                vertices.push_back(s.vertices);
+                indices.push_back(s.indices);
+                uploadBytes.push_back(s.uploadBytes);
+                lodUnits.push_back(s.lodUnits);
+                lodSkippedSlots.push_back(s.lodSkippedSlots);
+                untextured.push_back(s.untexturedBatches);
+            }
+
+            QJsonObject phaseMs;
+            for (const Series& p : phases) phaseMs.insert(p.name, percentiles(p.ms));
+
+            QJsonObject perFrame;
+            perFrame.insert("drawCalls", meanMax(drawCalls));
+            perFrame.insert("vertices", meanMax(vertices));
+            perFrame.insert("indices", meanMax(indices));
+            perFrame.insert("uploadBytes", meanMax(uploadBytes));
+            perFrame.insert("lodUnits", meanMax(lodUnits));
+            perFrame.insert("lodSkippedSlots", meanMax(lodSkippedSlots));
+            perFrame.insert("untexturedBatches", meanMax(untextured));
+
+            QJsonObject o;
+            o.insert("phasesMs", phaseMs);
+            o.insert("perFrame", perFrame);
+            return o;
+        };
+
+        QJsonObject lods;
+        if (lodMode == SpineLod::kLevels) {
+            for (int level = 0; level < SpineLod::kLevels; ++level) {
+                sim.setLodOverride(level);
+                lods.insert(QString::number(level), measure());
+            }
+        } else {
+            sim.setLodOverride(lodMode);
+            const QJsonObject o = measure();
+            result.insert("phasesMs", o.value("phasesMs"));
+            result.insert("perFrame", o.value("perFrame"));
+        }
+
+        QJsonObject config;
+        config.insert("units", int(units.size()));
+        config.insert("readyUnits", readyUnits);
+        config.insert("animation", parser.value(animOpt));
+        config.insert("frames", frames);
+        config.insert("warmup", warmup);
+        config.insert("dt", dt);
+        config.insert("width", size.width());
+        config.insert("height", size.height());
+        config.insert("threads", parser.value(threadsOpt).toInt());
+        config.insert("format", formatName);
+        config.insert("gpuSkinning", parser.isSet(skinOpt));
+        config.insert("lod", lodName);
+
+        QJsonObject glInfo;
+        glInfo.insert("vendor", reinterpret_cast<const char*>(gl->glGetString(GL_VENDOR)));
+        glInfo.insert("renderer", reinterpret_cast<const char*>(gl->glGetString(GL_RENDERER)));
+        glInfo.insert("version", reinterpret_cast<const char*>(gl->glGetString(GL_VERSION)));
+
+        result.insert("benchmark", "SgsSpineRenderBench");
+        result.insert("label", parser.value(labelOpt));
+        result.insert("gl", glInfo);
+        result.insert("config", config);
+        result.insert("loadMs", loadMs);
+        if (!lods.isEmpty()) result.insert("lods", lods);
+
+        fbo->release();
+        fbo.reset();
+        renderer.reset();   // releases the assets; needs the context current
+    }
+
+    const QByteArray json = QJsonDocument(result).toJson(QJsonDocument::Indented);
+    if (parser.isSet(outputOpt)) {
+        QFile out(parser.value(outputOpt));
+        if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate) || out.write(json) != json.size()) {
+            std::fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(outputOpt)));
+            return 1;
+        }
+    } else {
+        std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    }
+    context.doneCurrent();
+    return 0;
+}
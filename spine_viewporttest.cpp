@@ -0,0 +1,92 @@
+// Handle bookkeeping of SpineViewport without GL: units / spawnPools assigned again
+// after the viewport has rendered must not move any handle, and spawn / despawn must
+// keep addressing the instances the running simulation was created with.
+//
+//   SgsSpineViewportTest     (exit code 0 on success; run by ctest)
+
+#include <QGuiApplication>
+#include <QVariantMap>
+#include <cstdio>
+
+#include "spineviewport.h"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    if (!ok) {
+        std::fprintf(stderr, "FAIL: %s\n", what);
+        ++failures;
+    }
+}
+
+QVariantMap unit(const QString& name) {
+    QVariantMap m;
+    m.insert("name", name);
+    m.insert("atlas", name + ".atlas");
+    m.insert("skel", name + ".skel");
+    return m;
+}
+
+// Next command the viewport posted; unit -1 when the queue is empty.
+SpineCommand next(SpineViewport& view) {
+    SpineCommand c;
+    if (!view.commandQueue()->pop(&c)) c = SpineCommand();
+    return c;
+}
+}
+
+int main(int argc, char** argv) {
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    SpineViewport view;
+    QVariantMap pool = unit("fx");
+    pool.insert("count", 2);
+
+    // Before the first frame the lists may still change freely.
+    view.setUnits({unit("hero")});
+    view.setUnits({unit("hero"), unit("boss")});
+    view.setSpawnPools({pool});
+    check(view.unitHandle("boss") == 1, "boss handle before lock");
+
+    // What createRenderer() does; the simulation now holds 2 units + 2 fx instances.
+    view.lockLayout();
+
+    view.setUnits({unit("intro"), unit("hero"), unit("boss"), unit("extra")});
+    view.setUnits({unit("boss")});
+    check(view.units().size() == 2, "units unchanged after lock");
+    check(view.unitHandle("hero") == 0 && view.unitHandle("boss") == 1, "unit handles unchanged after lock");
+    check(view.unitHandle("extra") == -1, "no handle for a unit added after lock");
+
+    QVariantMap bigger = pool;
+    bigger.insert("count", 8);
+    view.setSpawnPools({bigger});
+
+    const int a = view.spawnUnit("fx", 10.0, 20.0);
+    const int b = view.spawnUnit("fx", 30.0, 40.0);
+    check(a == 2 && b == 3, "instances follow the 2 locked units");
+    check(view.spawnUnit("fx", 0.0, 0.0) == -1, "pool keeps its locked count");
+
+    SpineCommand c = next(view);
+    check(c.op == SpineCommand::Spawn && c.unit == a && c.x == 10.f && c.y == 20.f, "spawn command of a");
+    c = next(view);
+    check(c.op == SpineCommand::Spawn && c.unit == b, "spawn command of b");
+
+    view.despawnUnit(a);
+    c = next(view);
+    check(c.op == SpineCommand::Despawn && c.unit == a, "despawn command of a");
+    view.despawnUnit(a);
+    check(next(view).unit == -1, "second despawn of a is dropped");
+
+    // The freed instance comes back; the one in play is never handed out twice.
+    check(view.spawnUnit("fx", 0.0, 0.0) == a, "a is reused");
+    c = next(view);
+    check(c.op == SpineCommand::Spawn && c.unit == a, "respawn command of a");
+    view.despawnUnit(b);
+    c = next(view);
+    check(c.op == SpineCommand::Despawn && c.unit == b, "despawn command of b");
+
+    if (failures == 0) std::printf("SgsSpineViewportTest: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,448 @@
+#include "spineassetcache.h"
+#include "spinecommand.h"
+#include "spinefastcache.h"
+#include "spinemappedfile.h"
+#include "spinetexturepool.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLBuffer>
+#include <QOpenGLTexture>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+// Rows per upload step; a 2048-wide page moves 1 MB per band.
+constexpr int kUploadBandRows = 128;
+}
+
+SpineAssetCache& SpineAssetCache::instance() {
+    static SpineAssetCache cache;
+    return cache;
+}
+
+SpineAssetCache::SpineAssetCache() {
+    m_loaders.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+}
+
+QString SpineAssetCache::canonicalPath(const QString& path) {
+    QString canonical = QFileInfo(path).canonicalFilePath();
+    if (canonical.isEmpty()) canonical = QFileInfo("assets/" + path).canonicalFilePath();
+    return canonical.isEmpty() ? path : canonical;
+}
+
+QString SpineAssetCache::currentGroup() {
+    QOpenGLContext* ctx = QOpenGLContext::currentContext();
+    const quintptr group = ctx ? quintptr(ctx->shareGroup()) : 0;
+    return QString::number(quint64(group));
+}
+
+const SpineSkeletonAsset* SpineAssetCache::acquire(const QString& atlasPath, const QString& skelPath, float scale) {
+    QMutexLocker lock(&m_mutex);
+
+    const QString group = currentGroup();
+    const QString atlasKey = group + "|" + canonicalPath(atlasPath);
+    const QString skelKey = atlasKey + "|" + canonicalPath(skelPath) + "|" + QString::number(scale);
+
+    if (SkeletonEntry* e = m_skeletons.value(skelKey)) {
+        ++e->refs;
+        ++m_stats.hits;
+        return &e->asset;
+    }
+    ++m_stats.misses;
+
+    AtlasEntry* a = m_atlases.value(atlasKey);
+    if (!a) {
+        a = new AtlasEntry;
+        a->key = atlasKey;
+        a->path = atlasPath;
+        a->group = group;
+        m_atlases.insert(atlasKey, a);
+        ++m_stats.atlases;
+    }
+    ++a->refs;
+
+    auto* e = new SkeletonEntry;
+    e->key = skelKey;
+    e->skelPath = skelPath;
+    e->scale = scale;
+    e->atlas = a;
+    e->refs = 1;
+    m_skeletons.insert(skelKey, e);
+    m_entryOf.insert(&e->asset, e);
+    ++m_stats.skeletons;
+
+    m_loaders.start([this, e] { load(e); });
+    return &e->asset;
+}
+
+bool SpineAssetCache::ensureAtlasDecoded(AtlasEntry* a) {
+    QMutexLocker lock(&m_mutex);
+    while (a->state == AtlasLoading) m_stateChanged.wait(&m_mutex);
+    if (a->state != AtlasNotLoaded) return a->state != AtlasFailed;
+
+    a->state = AtlasLoading;
+    const QString path = a->path;
+    lock.unlock();
+
+    QElapsedTimer clock;
+    clock.start();
+
+    // Parses the .atlas text straight out of the mapping and decodes every page image;
+    // _spAtlasPage_createTexture only queues the pixels, so this is safe off the GL thread.
+    // With SGS_SPINE_CACHE_DIR set, a valid precompiled cache replaces both steps.
+    const QByteArray dir = SpineFastCache::pageDir(path);
+    spAtlas* atlas = SpineFastCache::enabled() ? SpineFastCache::load(path, dir) : nullptr;
+    const bool fromCache = atlas != nullptr;
+    qint64 mapped = 0;
+    if (!atlas) {
+        SpineMappedFile file(path);
+        if (file.isOpen()) {
+            atlas = spAtlas_create(file.data(), file.size(), dir.constData(), nullptr);
+            if (file.isMapped()) mapped = file.size();
+        }
+        // First run or stale cache: write it now, while the decoded pages are still
+        // queued and the render thread cannot see this atlas yet.
+        if (atlas && SpineFastCache::enabled()) SpineFastCache::store(path, dir, atlas);
+    }
+
+    lock.relock();
+    m_stats.loadNs += clock.nsecsElapsed();
+    m_stats.mappedBytes += mapped;
+    if (fromCache) ++m_stats.fastCacheHits;
+    if (!atlas) {
+        qWarning() << "[SpineAssetCache] failed to load atlas:" << path;
+        a->state = AtlasFailed;
+    } else {
+        a->atlas = atlas;
+        a->state = AtlasDecoded;
+        for (spAtlasPage* page = atlas->pages; page; page = page->next) {
+            a->bytes += qint64(page->width) * page->height * 4;
+            ++a->pendingPages;
+        }
+        if (a->pendingPages == 0) a->state = AtlasUploaded;
+        m_atlasOf.insert(atlas, a);
+        m_stats.residentBytes += a->bytes;
+    }
+    m_stateChanged.wakeAll();
+    return a->state != AtlasFailed;
+}
+
+void SpineAssetCache::load(SkeletonEntry* e) {
+    SpineSkeletonAsset& asset = e->asset;
+
+    if (!ensureAtlasDecoded(e->atlas)) {
+        fail(e);
+        return;
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+
+    // The binary reader copies everything it keeps, so the mapping only has to outlive
+    // the parse; no heap copy of the file is made.
+    SpineMappedFile file(e->skelPath);
+    if (!file.isOpen()) {
+        qWarning() << "[SpineAssetCache] missing/empty skel:" << e->skelPath;
+        fail(e);
+        return;
+    }
+
+    spSkeletonBinary* binary = spSkeletonBinary_create(e->atlas->atlas);
+    binary->scale = e->scale;
+    spSkeletonData* data = spSkeletonBinary_readSkeletonData(
+        binary,
+        reinterpret_cast<const unsigned char*>(file.data()),
+        file.size()
+    );
+    const qint64 fileBytes = file.size();
+    const qint64 mapped = file.isMapped() ? fileBytes : 0;
+    file.close();
+
+    if (!data) {
+        qWarning() << "[SpineAssetCache] failed to parse skel:" << e->skelPath
+                   << "error:" << (binary->error ? binary->error : "unknown");
+        spSkeletonBinary_dispose(binary);
+        fail(e);
+        return;
+    }
+    spSkeletonBinary_dispose(binary);
+
+    // Handle -> animation table, so commands never search by name.
+    std::vector<spAnimation*> animations;
+    for (int i = 0; i < data->animationsCount; ++i) {
+        const int handle = SpineCommand::animationHandle(QByteArray(data->animations[i]->name));
+        if (handle >= int(animations.size())) animations.resize(size_t(handle) + 1, nullptr);
+        animations[(size_t)handle] = data->animations[i];
+    }
+    SpineSkinnedMeshes skinned = SpineSkinning::prepare(data);
+    SpineLodMeshes lodMeshes = SpineLod::prepare(data);
+
+    QMutexLocker lock(&m_mutex);
+    asset.atlas = e->atlas->atlas;
+    asset.data = data;
+    asset.stateData = spAnimationStateData_create(data);
+    asset.animations.swap(animations);
+    asset.skinnedMeshes.swap(skinned);
+    asset.lodMeshes.swap(lodMeshes);
+    e->bytes = fileBytes;
+    m_stats.residentBytes += e->bytes;
+    m_stats.loadNs += clock.nsecsElapsed();
+    m_stats.mappedBytes += mapped;
+
+    asset.state.store(e->atlas->state == AtlasUploaded ? SpineSkeletonAsset::Ready
+                                                       : SpineSkeletonAsset::Uploading);
+    updateProgress(e);
+    m_stateChanged.wakeAll();
+}
+
+void SpineAssetCache::fail(SkeletonEntry* e) {
+    QMutexLocker lock(&m_mutex);
+    e->asset.state = SpineSkeletonAsset::Failed;
+    m_stateChanged.wakeAll();
+}
+
+void SpineAssetCache::updateProgress(SkeletonEntry* e) {
+    // First half: decode + parse. Second half: texture upload.
+    const AtlasEntry* a = e->atlas;
+    float p = 0.f;
+    if (a->state >= AtlasDecoded && a->state != AtlasFailed) p += 0.25f;
+    if (e->asset.data) p += 0.25f;
+    if (a->state == AtlasUploaded) p += 0.5f;
+    else if (a->bytes > 0) p += 0.5f * float(a->uploadedBytes) / float(a->bytes);
+    e->asset.progress = p;
+}
+
+void SpineAssetCache::queueUpload(spAtlasPage* page, const QImage& image) {
+    auto* u = new Upload;
+    u->page = page;
+    u->image = image;
+    QMutexLocker lock(&m_mutex);
+    m_uploads.push_back(u);
+    ++m_stats.pendingUploads;
+}
+
+QImage SpineAssetCache::pendingImage(const spAtlasPage* page) const {
+    QMutexLocker lock(&m_mutex);
+    for (const Upload* u : m_uploads) {
+        if (u->page == page) return u->image;
+    }
+    return QImage();
+}
+
+void SpineAssetCache::cancelUpload(spAtlasPage* page) {
+    QMutexLocker lock(&m_mutex);
+    for (auto it = m_uploads.begin(); it != m_uploads.end(); ++it) {
+        if ((*it)->page != page) continue;
+        delete *it;
+        m_uploads.erase(it);
+        --m_stats.pendingUploads;
+        return;
+    }
+}
+
+void SpineAssetCache::processUploads(QOpenGLBuffer* pbo, qint64 budgetNs) {
+    QOpenGLContext* ctx = QOpenGLContext::currentContext();
+    if (!ctx) return;
+    QOpenGLExtraFunctions* gl = ctx->extraFunctions();
+    const QString group = currentGroup();
+
+    QElapsedTimer clock;
+    clock.start();
+
+    for (;;) {
+        Upload* u = nullptr;
+        {
+            QMutexLocker lock(&m_mutex);
+            for (auto it = m_uploads.begin(); it != m_uploads.end(); ++it) {
+                // Pages of an atlas still being created are not registered yet.
+                const AtlasEntry* a = m_atlasOf.value((*it)->page->atlas);
+                if (!a || a->group != group) continue;
+                u = *it;
+                m_uploads.erase(it);
+                break;
+            }
+        }
+        if (!u) return;
+
+        auto* page = static_cast<SpinePageTexture*>(u->page->rendererObject);
+        const int w = u->image.width();
+        const int h = u->image.height();
+        const bool pooled = SpineTexturePool::enabled();
+        if (pooled) {
+            if (page->array) {
+                gl->glBindTexture(GL_TEXTURE_2D_ARRAY, page->array->textureId());
+            } else if (!pool(group)->place(page, w, h, gl)) {
+                // Without a layer the page's batches are not drawn (SpineRenderer::submit
+                // skips them); the unit still loads.
+                u->nextRow = h;
+            }
+        } else {
+            if (!page->texture) page->texture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+            QOpenGLTexture* tex = page->texture;
+            if (!tex->isCreated()) {
+                tex->setSize(w, h);
+                tex->setFormat(QOpenGLTexture::RGBA8_UNorm);
+                tex->setMipLevels(1);
+                tex->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+                tex->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+                tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+            }
+            tex->bind();
+        }
+
+        // Band by band through the PBO, so one huge page cannot blow the frame budget
+        // and the copy into GL memory happens asynchronously to the driver.
+        auto uploadBand = [&](int row, int rows, const void* pixels) {
+            if (pooled)
+                gl->glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, row, page->layer, w, rows, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            else
+                gl->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, w, rows, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        };
+        while (u->nextRow < h) {
+            const int rows = qMin(kUploadBandRows, h - u->nextRow);
+            const int bandBytes = w * 4 * rows;
+            const uchar* src = u->image.constScanLine(u->nextRow);
+
+            bool viaPbo = false;
+            if (pbo && pbo->isCreated()) {
+                pbo->bind();
+                pbo->allocate(bandBytes);   // orphan: never waits on the previous band
+                if (void* dst = pbo->mapRange(0, bandBytes, QOpenGLBuffer::RangeWrite | QOpenGLBuffer::RangeInvalidateBuffer)) {
+                    std::memcpy(dst, src, (size_t)bandBytes);
+                    pbo->unmap();
+                    uploadBand(u->nextRow, rows, nullptr);
+                    viaPbo = true;
+                }
+                pbo->release();
+            }
+            if (!viaPbo) uploadBand(u->nextRow, rows, src);
+
+            u->nextRow += rows;
+
+            QMutexLocker lock(&m_mutex);
+            if (AtlasEntry* a = m_atlasOf.value(u->page->atlas)) a->uploadedBytes += bandBytes;
+            if (clock.nsecsElapsed() >= budgetNs) break;
+        }
+        if (pooled) gl->glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        else page->texture->release();
+
+        QMutexLocker lock(&m_mutex);
+        AtlasEntry* a = m_atlasOf.value(u->page->atlas);
+        if (u->nextRow < h) {
+            // Out of budget; resume this page first next frame.
+            m_uploads.push_front(u);
+            if (a) {
+                for (auto* e : m_skeletons) if (e->atlas == a) updateProgress(e);
+            }
+            return;
+        }
+
+        delete u;
+        --m_stats.pendingUploads;
+        if (a && --a->pendingPages == 0) {
+            a->state = AtlasUploaded;
+        }
+        if (a) {
+            for (auto* e : m_skeletons) {
+                if (e->atlas != a) continue;
+                if (a->state == AtlasUploaded && e->asset.state.load() == SpineSkeletonAsset::Uploading)
+                    e->asset.state = SpineSkeletonAsset::Ready;
+                updateProgress(e);
+            }
+        }
+        if (clock.nsecsElapsed() >= budgetNs) return;
+    }
+}
+
+spAtlas* SpineAssetCache::releaseAtlas(AtlasEntry* a) {
+    if (--a->refs > 0) return nullptr;
+
+    spAtlas* atlas = a->atlas;
+    m_stats.residentBytes -= a->bytes;
+    --m_stats.atlases;
+    m_atlasOf.remove(atlas);
+    m_atlases.remove(a->key);
+    delete a;
+    return atlas;
+}
+
+void SpineAssetCache::release(const SpineSkeletonAsset* asset) {
+    if (!asset) return;
+
+    SkeletonEntry* e = nullptr;
+    {
+        QMutexLocker lock(&m_mutex);
+        e = m_entryOf.value(asset);
+        if (!e || --e->refs > 0) return;
+        m_entryOf.remove(asset);
+        m_skeletons.remove(e->key);
+
+        // The loader may still be working on it; it owns the entry until the state settles.
+        while (e->asset.state.load() == SpineSkeletonAsset::Loading) m_stateChanged.wait(&m_mutex);
+    }
+
+    if (e->asset.stateData) spAnimationStateData_dispose(e->asset.stateData);
+    if (e->asset.data) spSkeletonData_dispose(e->asset.data);
+
+    spAtlas* atlas = nullptr;
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stats.residentBytes -= e->bytes;
+        --m_stats.skeletons;
+        atlas = releaseAtlas(e->atlas);
+    }
+    delete e;
+
+    // Disposing pages deletes textures and cancels queued uploads, which takes m_mutex.
+    if (atlas) spAtlas_dispose(atlas);
+}
+
+SpineAssetCache::Stats SpineAssetCache::stats() const {
+    QMutexLocker lock(&m_mutex);
+    return m_stats;
+}
+
+QVariantMap SpineAssetCache::statsMap() const {
+    const Stats s = stats();
+    QVariantMap m;
+    m.insert("hits", s.hits);
+    m.insert("misses", s.misses);
+    m.insert("atlases", s.atlases);
+    m.insert("skeletons", s.skeletons);
+    m.insert("residentBytes", s.residentBytes);
+    m.insert("pendingUploads", s.pendingUploads);
+    m.insert("loadMs", double(s.loadNs) / 1e6);
+    m.insert("mappedBytes", s.mappedBytes);
+    m.insert("fastCacheHits", s.fastCacheHits);
+
+    SpineTexturePool::Stats pool;
+    {
+        QMutexLocker lock(&m_mutex);
+        for (const SpineTexturePool* p : m_pools) {
+            const SpineTexturePool::Stats ps = p->stats();
+            pool.arrays += ps.arrays;
+            pool.layers += ps.layers;
+            pool.capacity += ps.capacity;
+            pool.bytes += ps.bytes;
+            pool.grows += ps.grows;
+        }
+    }
+    m.insert("poolArrays", pool.arrays);
+    m.insert("poolLayers", pool.layers);
+    m.insert("poolCapacity", pool.capacity);
+    m.insert("poolBytes", pool.bytes);
+    m.insert("poolGrows", pool.grows);
+    return m;
+}
+
+SpineTexturePool* SpineAssetCache::pool(const QString& group) {
+    QMutexLocker lock(&m_mutex);
+    SpineTexturePool*& p = m_pools[group];
+    if (!p) p = new SpineTexturePool;
+    return p;
+}
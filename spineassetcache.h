@@ -0,0 +1,154 @@
+#pragma once
+#include <QString>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QVariantMap>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#ifdef slots
+#  undef slots
+#endif
+#ifdef signals
+#  undef signals
+#endif
+#ifndef NOMINMAX
+#  define NOMINMAX
+#endif
+
+extern "C" {
+#include <spine/spine.h>
+}
+
+#include "spinelod.h"
+#include "spineskinning.h"
+
+class QOpenGLBuffer;
+class SpineTexturePool;
+
+// Immutable, shareable result of loading one .atlas/.skel pair.
+// Units create their own spSkeleton / spAnimationState from it once it is Ready.
+struct SpineSkeletonAsset {
+    enum State { Loading, Uploading, Ready, Failed };
+
+    spAtlas* atlas = nullptr;
+    spSkeletonData* data = nullptr;
+    spAnimationStateData* stateData = nullptr;
+    // Indexed by SpineCommand::animationHandle(name); nullptr where this skeleton has no
+    // animation of that name.
+    std::vector<spAnimation*> animations;
+    // Weighted meshes the GPU skinning path can draw from static buffers.
+    SpineSkinnedMeshes skinnedMeshes;
+    // Reduced meshes for the far level of detail (SpineLod::prepare).
+    SpineLodMeshes lodMeshes;
+
+    // Written by the loader; the fields above are valid once state reads Uploading/Ready.
+    std::atomic<int> state{Loading};
+    std::atomic<float> progress{0.f};
+};
+
+// Process-wide, reference-counted cache of atlases and skeleton data.
+// Atlases are keyed by canonical path, skeleton data by canonical .skel path + scale +
+// atlas. Both are scoped to the current GL share group since atlas pages own textures.
+//
+// Loading is asynchronous: acquire() returns immediately and a loader thread reads the
+// files, decodes the atlas pages and parses the skeleton. Texture upload is the only
+// GL step; processUploads() does it on the render thread a band of rows at a time
+// under a per-frame time budget.
+class SpineAssetCache {
+public:
+    struct Stats {
+        int hits = 0;
+        int misses = 0;
+        int atlases = 0;
+        int skeletons = 0;
+        qint64 residentBytes = 0;   // texture memory + skeleton source size
+        int pendingUploads = 0;
+        qint64 loadNs = 0;          // loader time spent reading/parsing .atlas + .skel
+        qint64 mappedBytes = 0;     // source bytes parsed in place from a file mapping
+        int fastCacheHits = 0;      // atlases loaded from SpineFastCache
+    };
+
+    static SpineAssetCache& instance();
+
+    // Needs a current context (to pick the share group). Never returns nullptr for a
+    // well-formed request; check asset->state for progress or failure. Every call needs
+    // a matching release() on a thread with the same group's context current.
+    const SpineSkeletonAsset* acquire(const QString& atlasPath, const QString& skelPath, float scale);
+    void release(const SpineSkeletonAsset* asset);
+
+    // Render thread: uploads decoded atlas pages for the current share group through
+    // pbo until budgetNs is spent (at least one band per call).
+    void processUploads(QOpenGLBuffer* pbo, qint64 budgetNs);
+
+    // Called by _spAtlasPage_createTexture / _spAtlasPage_disposeTexture.
+    void queueUpload(spAtlasPage* page, const QImage& image);
+    void cancelUpload(spAtlasPage* page);
+
+    // Decoded pixels of a page still waiting for upload (null once it has gone to GL).
+    QImage pendingImage(const spAtlasPage* page) const;
+
+    Stats stats() const;
+    QVariantMap statsMap() const;
+
+    // Same lookup order as _spUtil_readFile: as given, then under assets/.
+    static QString canonicalPath(const QString& path);
+
+private:
+    enum AtlasState { AtlasNotLoaded, AtlasLoading, AtlasDecoded, AtlasUploaded, AtlasFailed };
+
+    struct AtlasEntry {
+        QString key;
+        QString path;
+        QString group;
+        spAtlas* atlas = nullptr;
+        AtlasState state = AtlasNotLoaded;
+        int refs = 0;
+        qint64 bytes = 0;
+        qint64 uploadedBytes = 0;
+        int pendingPages = 0;
+    };
+    struct SkeletonEntry {
+        SpineSkeletonAsset asset;
+        QString key;
+        QString skelPath;
+        float scale = 1.f;
+        AtlasEntry* atlas = nullptr;
+        int refs = 0;
+        qint64 bytes = 0;
+    };
+    struct Upload {
+        spAtlasPage* page = nullptr;
+        QImage image;
+        int nextRow = 0;
+    };
+
+    SpineAssetCache();
+
+    static QString currentGroup();
+
+    void load(SkeletonEntry* e);
+    void fail(SkeletonEntry* e);
+    bool ensureAtlasDecoded(AtlasEntry* a);
+    void updateProgress(SkeletonEntry* e);   // needs m_mutex
+    spAtlas* releaseAtlas(AtlasEntry* a);    // needs m_mutex; returns an atlas to dispose unlocked
+    SpineTexturePool* pool(const QString& group);   // texture pool mode; made on first use
+
+    // Entries are heap-allocated so the asset pointers handed out stay put when the
+    // hashes rehash.
+    mutable QMutex m_mutex;
+    QWaitCondition m_stateChanged;   // atlas decoded / skeleton load settled
+    QHash<QString, AtlasEntry*> m_atlases;
+    QHash<const spAtlas*, AtlasEntry*> m_atlasOf;
+    QHash<QString, SkeletonEntry*> m_skeletons;
+    QHash<const SpineSkeletonAsset*, SkeletonEntry*> m_entryOf;
+    std::deque<Upload*> m_uploads;
+    QHash<QString, SpineTexturePool*> m_pools;   // per share group, never freed like the cache
+    Stats m_stats;
+
+    QThreadPool m_loaders;
+};
@@ -0,0 +1,123 @@
+#include "spinebakedanimation.h"
+#include "framearena.h"
+
+#include <QElapsedTimer>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+namespace {
+bool sameBatches(const SpineDrawList& a, const SpineDrawList& b) {
+    if (a.batches.size() != b.batches.size()) return false;
+    for (size_t i = 0; i < a.batches.size(); ++i) {
+        const SpineDrawList::Batch& x = a.batches[i];
+        const SpineDrawList::Batch& y = b.batches[i];
+        if (x.kind != y.kind || x.tex != y.tex || x.array != y.array || x.layer != y.layer || x.blendMode != y.blendMode
+            || x.firstIndex != y.firstIndex || x.indexCount != y.indexCount || x.skinned != y.skinned
+            || std::memcmp(x.color, y.color, sizeof x.color) != 0 || std::memcmp(x.dark, y.dark, sizeof x.dark) != 0)
+            return false;
+    }
+    return true;
+}
+
+// Same triangles over the same number of vertices: positions can be blended.
+bool sameTopology(const SpineDrawList& a, const SpineDrawList& b) {
+    return a.vertexCount() == b.vertexCount() && a.wideIndices == b.wideIndices
+        && a.indices == b.indices && a.indices32 == b.indices32 && sameBatches(a, b);
+}
+
+template <class V>
+void lerpPositions(std::vector<V>& out, const std::vector<V>& next, float t) {
+    for (size_t i = 0; i < out.size(); ++i) {
+        out[i].x += (next[i].x - out[i].x) * t;
+        out[i].y += (next[i].y - out[i].y) * t;
+    }
+}
+
+template <class T>
+qint64 heapBytes(const std::vector<T>& v) {
+    return qint64(v.capacity() * sizeof(T));
+}
+}
+
+std::unique_ptr<SpineBakedAnimation> SpineBakedAnimation::bake(spSkeleton* skeleton, spAnimation* animation,
+                                                               spSkeletonClipping* clipper, FrameArena& arena,
+                                                               float rate, SpineDrawList::VertexFormat format,
+                                                               bool stencilClipping, int maxFrames)
+{
+    if (!skeleton || !animation || !clipper || rate <= 0.f || animation->duration <= 0.f) return nullptr;
+    const int count = qMax(1, int(std::ceil(animation->duration * rate)));
+    if (count > maxFrames) return nullptr;
+
+    std::unique_ptr<SpineBakedAnimation> baked(new SpineBakedAnimation);
+    baked->m_rate = rate;
+    baked->m_duration = animation->duration;
+    baked->m_format = format;
+    baked->m_stencilClipping = stencilClipping;
+    baked->m_frames.reserve(size_t(count));
+
+    SpineDrawList scratch;
+    scratch.format = format;
+    scratch.stencilClipping = stencilClipping;
+    for (int i = 0; i < count; ++i) {
+        spSkeleton_setToSetupPose(skeleton);
+        spAnimation_apply(animation, skeleton, 0.f, float(i) / rate, 1, nullptr, nullptr, 1.f,
+                          SP_MIX_POSE_SETUP, SP_MIX_DIRECTION_IN);
+        spSkeleton_updateWorldTransform(skeleton);
+        arena.reset();
+        scratch.build(skeleton, clipper, arena);
+        // Copies come out sized to fit, unlike the scratch list.
+        baked->m_frames.push_back(scratch);
+    }
+
+    baked->m_lerpToNext.resize(size_t(count));
+    for (int i = 0; i < count; ++i) {
+        const SpineDrawList& f = baked->m_frames[size_t(i)];
+        baked->m_lerpToNext[size_t(i)] = sameTopology(f, baked->m_frames[size_t((i + 1) % count)]);
+
+        baked->m_bytes += qint64(sizeof(SpineDrawList));
+        baked->m_bytes += heapBytes(f.verts) + heapBytes(f.packedVerts) + heapBytes(f.compactVerts);
+        baked->m_bytes += heapBytes(f.indices) + heapBytes(f.indices32) + heapBytes(f.batches) + heapBytes(f.bones);
+    }
+    baked->m_bytes += qint64(baked->m_lerpToNext.capacity() / 8);
+    return baked;
+}
+
+void SpineBakedAnimation::sample(float time, SpineDrawList& out) const {
+    QElapsedTimer clock;
+    clock.start();
+
+    const int count = int(m_frames.size());
+    time = std::fmod(time, m_duration);
+    if (time < 0.f) time += m_duration;
+    const int i = qMin(count - 1, int(time * m_rate));
+    // The last frame's interval ends at the loop point, which may come early.
+    const float start = float(i) / m_rate;
+    const float end = qMin(float(i + 1) / m_rate, m_duration);
+    const float t = end > start ? (time - start) / (end - start) : 0.f;
+
+    // Assignment reuses out's storage once it has seen the largest frame.
+    const size_t caps[] = {out.verts.capacity(), out.packedVerts.capacity(), out.compactVerts.capacity(),
+                           out.indices.capacity(), out.indices32.capacity(), out.batches.capacity()};
+    const SpineDrawList& from = m_frames[size_t(i)];
+    out = from;
+    const size_t newCaps[] = {out.verts.capacity(), out.packedVerts.capacity(), out.compactVerts.capacity(),
+                              out.indices.capacity(), out.indices32.capacity(), out.batches.capacity()};
+    int grown = 0;
+    for (size_t k = 0; k < std::size(caps); ++k) grown += newCaps[k] != caps[k] ? 1 : 0;
+    if (t > 0.f && m_lerpToNext[size_t(i)]) {
+        const SpineDrawList& to = m_frames[size_t((i + 1) % count)];
+        switch (out.format) {
+        case SpineDrawList::PackedVertex:     lerpPositions(out.packedVerts, to.packedVerts, t); break;
+        case SpineDrawList::BatchColorVertex: lerpPositions(out.compactVerts, to.compactVerts, t); break;
+        default:                              lerpPositions(out.verts, to.verts, t); break;
+        }
+        out.bounds.add(to.bounds);
+    }
+
+    out.heapAllocs = grown;
+    out.animateNs = 0;
+    out.worldNs = 0;
+    out.clipNs = 0;
+    out.buildNs = clock.nsecsElapsed();
+}
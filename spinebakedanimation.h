@@ -0,0 +1,45 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "spinedrawlist.h"
+
+class FrameArena;
+
+// One looping animation of one unit, tessellated at a fixed rate into complete draw
+// lists. Playback copies (and, where two neighbouring frames have the same topology,
+// lerps the positions of) cached frames instead of evaluating the skeleton.
+// Frames are built with an unbounded view and without GPU skinning, so they hold every
+// slot; only whole-unit culling applies during playback.
+class SpineBakedAnimation {
+public:
+    // Longest cache bake() builds by default (a minute at 30 fps).
+    static constexpr int kMaxFrames = 1800;
+
+    // Poses skeleton through animation (from the setup pose) at rate frames per second
+    // and builds one list per frame in format. The skeleton is left in the last pose.
+    // Returns nullptr for an empty animation or one needing more than maxFrames.
+    static std::unique_ptr<SpineBakedAnimation> bake(spSkeleton* skeleton, spAnimation* animation,
+                                                     spSkeletonClipping* clipper, FrameArena& arena,
+                                                     float rate, SpineDrawList::VertexFormat format,
+                                                     bool stencilClipping, int maxFrames = kMaxFrames);
+
+    // Pose at time (wrapped to the animation's duration) into out.
+    void sample(float time, SpineDrawList& out) const;
+
+    float duration() const { return m_duration; }
+    int frameCount() const { return int(m_frames.size()); }
+    SpineDrawList::VertexFormat format() const { return m_format; }
+    bool stencilClipping() const { return m_stencilClipping; }
+    // Heap held by the cached frames.
+    qint64 bytes() const { return m_bytes; }
+
+private:
+    std::vector<SpineDrawList> m_frames;
+    std::vector<bool> m_lerpToNext;     // frame i and i+1 (wrapping) share vertices/indices/batches
+    float m_rate = 30.f;
+    float m_duration = 0.f;
+    SpineDrawList::VertexFormat m_format = SpineDrawList::FloatVertex;
+    bool m_stencilClipping = false;
+    qint64 m_bytes = 0;
+};
@@ -0,0 +1,61 @@
+#include "spinecommand.h"
+
+#include <QHash>
+#include <QMutexLocker>
+#include <QReadWriteLock>
+
+namespace {
+QReadWriteLock g_namesLock;
+QHash<QByteArray, int> g_names;
+}
+
+int SpineCommand::animationHandle(const QByteArray& name) {
+    {
+        QReadLocker lock(&g_namesLock);
+        const auto it = g_names.constFind(name);
+        if (it != g_names.constEnd()) return it.value();
+    }
+    QWriteLocker lock(&g_namesLock);
+    const auto it = g_names.constFind(name);
+    if (it != g_names.constEnd()) return it.value();
+    const int handle = int(g_names.size());
+    g_names.insert(name, handle);
+    return handle;
+}
+
+SpineCommandQueue::SpineCommandQueue(int capacity) {
+    size_t size = 2;
+    while (size < size_t(qMax(2, capacity))) size <<= 1;
+    m_ring.resize(size);
+    m_mask = size - 1;
+}
+
+bool SpineCommandQueue::push(const SpineCommand& c) {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) > m_mask) return false;
+    m_ring[head & m_mask] = c;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool SpineCommandQueue::pop(SpineCommand* out) {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire)) return false;
+    *out = m_ring[tail & m_mask];
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool SpineCommandQueue::isEmpty() const {
+    return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire);
+}
+
+void SpineCommandQueue::setWaker(std::function<void()> fn) {
+    QMutexLocker lock(&m_wakerMutex);
+    m_waker = std::move(fn);
+}
+
+void SpineCommandQueue::wake() {
+    QMutexLocker lock(&m_wakerMutex);
+    if (m_waker) m_waker();
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <QByteArray>
+#include <QMutex>
+#include <QtGlobal>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+// One pre-resolved command. Units are addressed by their index in the viewport's unit
+// list (spawn pool instances follow the configured units), animations by a
+// process-wide handle for their name, so the simulation applies a command with two
+// array lookups. Spawn / Despawn take a preallocated pool instance in and out of play.
+struct SpineCommand {
+    enum Op : quint8 { SetAnimation, AddAnimation, Spawn, Despawn };
+
+    quint8 op = SetAnimation;
+    bool loop = false;
+    qint16 track = 0;
+    qint32 unit = -1;
+    qint32 animation = -1;
+    float delay = 0.f;      // AddAnimation only
+    float x = 0.f;          // Spawn only: skeleton position
+    float y = 0.f;
+
+    // Interns an animation name; the same name always yields the same handle.
+    // Thread-safe. Loaders use it to build SpineSkeletonAsset::animations.
+    static int animationHandle(const QByteArray& name);
+};
+
+// Fixed-size single-producer / single-consumer ring. The viewport pushes on the GUI
+// thread (or the render thread during synchronize, while the GUI thread is blocked);
+// the simulation thread pops.
+class SpineCommandQueue {
+public:
+    explicit SpineCommandQueue(int capacity = 1024);   // rounded up to a power of two
+
+    // Producer. False when full; the caller keeps the command and retries later.
+    bool push(const SpineCommand& c);
+    // Consumer.
+    bool pop(SpineCommand* out);
+    bool isEmpty() const;
+
+    // The consumer registers how to be woken (cleared before it goes away); producers
+    // call wake() after a burst of pushes.
+    void setWaker(std::function<void()> fn);
+    void wake();
+
+private:
+    std::vector<SpineCommand> m_ring;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_head{0};   // next slot to write, producer-owned
+    alignas(64) std::atomic<size_t> m_tail{0};   // next slot to read, consumer-owned
+
+    QMutex m_wakerMutex;
+    std::function<void()> m_waker;
+};
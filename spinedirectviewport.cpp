@@ -0,0 +1,72 @@
+#include "spinedirectviewport.h"
+#include "spinerenderer.h"
+
+#include <QDebug>
+#include <QMatrix4x4>
+#include <QQuickWindow>
+#include <QSGRenderNode>
+#include <QSGRendererInterface>
+#include <QtMath>
+
+namespace {
+// Owns the renderer; the scene graph deletes the node on the render thread with the
+// context current, which is what SpineRenderer's destructor needs.
+class SpineRenderNode : public QSGRenderNode {
+public:
+    explicit SpineRenderNode(SpineRenderer* renderer) : m_renderer(renderer) {}
+    ~SpineRenderNode() override { delete m_renderer; }
+
+    // Render thread, GUI thread blocked.
+    void sync(SpineViewportBase* item, const QSize& size) {
+        m_renderer->synchronize(item);
+        m_renderer->setViewSize(size);
+        m_size = size;
+    }
+
+    void render(const RenderState* state) override {
+        // Item space has its origin top left with y down; skeletons are centered, y up.
+        QMatrix4x4 mvp = *state->projectionMatrix() * *matrix();
+        mvp.translate(m_size.width() * 0.5f, m_size.height() * 0.5f);
+        mvp.scale(1.f, -1.f);
+        m_renderer->renderDirect(mvp, float(inheritedOpacity()));
+    }
+
+    StateFlags changedStates() const override {
+        return BlendState | StencilState | ScissorState | ColorState | DepthState | CullState;
+    }
+    // Slots may reach past the item box, so no BoundedRectRendering.
+    RenderingFlags flags() const override { return RenderingFlags(); }
+    QRectF rect() const override { return QRectF(0, 0, m_size.width(), m_size.height()); }
+
+private:
+    SpineRenderer* m_renderer;
+    QSize m_size;
+};
+}
+
+SpineDirectViewport::SpineDirectViewport(QQuickItem* parent) : SpineViewportBase(parent) {
+    setFlag(ItemHasContents);
+}
+
+QSGNode* SpineDirectViewport::updatePaintNode(QSGNode* old, UpdatePaintNodeData*) {
+    auto* node = static_cast<SpineRenderNode*>(old);
+    const QSize size(qCeil(width()), qCeil(height()));
+    if (size.isEmpty()) {
+        delete node;
+        return nullptr;
+    }
+    if (!node) {
+        if (window()->rendererInterface()->graphicsApi() != QSGRendererInterface::OpenGL) {
+            static bool warned = false;
+            if (!warned) qWarning() << "[SpineDirectViewport] needs the OpenGL scene graph; nothing is drawn";
+            warned = true;
+            return nullptr;
+        }
+        node = new SpineRenderNode(createSpineRenderer());
+    }
+    node->sync(this, size);
+
+    // The scene graph only redraws when asked; Adaptive keeps asking while anything moves.
+    if (updateMode() == Adaptive && animating()) update();
+    return node;
+}
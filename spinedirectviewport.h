@@ -0,0 +1,21 @@
+#pragma once
+#include "spineviewportbase.h"
+
+// Viewport that draws its units straight into the scene graph's render pass through a
+// QSGRenderNode instead of into an FBO that Qt Quick then composites (SpineViewport).
+// Same properties, commands and SpineRenderer pipeline; it saves the full-size clear,
+// the second textured pass and the vertical flip. OpenGL scene graph only.
+//
+// Differences from SpineViewport: nothing is retained between frames, so every scene
+// graph frame redraws (no idle skipping) and layers are ignored; the item is not a
+// texture provider, so ShaderEffect sources need layer.enabled. Stencil clip ranges
+// reset the stencil under the item's bounding box, so a rotated clip from an ancestor
+// does not apply to frames that have them.
+class SpineDirectViewport : public SpineViewportBase {
+    Q_OBJECT
+public:
+    explicit SpineDirectViewport(QQuickItem* parent = nullptr);
+
+protected:
+    QSGNode* updatePaintNode(QSGNode* old, UpdatePaintNodeData* data) override;
+};
@@ -0,0 +1,590 @@
+#include "spinedrawlist.h"
+#include "framearena.h"
+#include "spinelod.h"
+#include "spineskinning.h"
+#include "spinetexturepool.h"
+#include "spinevertexkernels.h"
+
+#include <QElapsedTimer>
+#include <algorithm>
+
+static_assert(sizeof(SpineDrawList::Vtx) == 8 * sizeof(float), "SpineVertexKernels write 8-float records");
+
+void SpineDrawList::clear() {
+    verts.clear();
+    packedVerts.clear();
+    compactVerts.clear();
+    indices.clear();
+    indices32.clear();
+    wideIndices = false;
+    batches.clear();
+    bones.clear();
+    slots = 0;
+    culledSlots = 0;
+    skinnedSlots = 0;
+    stencilClips = 0;
+    clippedSlots = 0;
+    lodSkippedSlots = 0;
+    lodMeshes = 0;
+    culled = false;
+    bounds = Bounds();
+    heapAllocs = 0;
+    animateNs = 0;
+    worldNs = 0;
+    clipNs = 0;
+    buildNs = 0;
+}
+
+void SpineDrawList::Bounds::add(const Bounds& o) {
+    minX = qMin(minX, o.minX);
+    minY = qMin(minY, o.minY);
+    maxX = qMax(maxX, o.maxX);
+    maxY = qMax(maxY, o.maxY);
+}
+
+void SpineDrawList::Bounds::add(const float* xy, int floats) {
+    for (int i = 0; i + 1 < floats; i += 2) {
+        minX = qMin(minX, xy[i]);
+        maxX = qMax(maxX, xy[i]);
+        minY = qMin(minY, xy[i + 1]);
+        maxY = qMax(maxY, xy[i + 1]);
+    }
+}
+
+namespace {
+// Local vertices of a mesh bound to its slot's bone alone (deform applied), or nullptr
+// for weighted meshes. World = bone affine of these, as in spVertexAttachment_computeWorldVertices.
+const float* unweightedVertices(const spMeshAttachment* att, const spSlot* slot) {
+    if (att->super.bones) return nullptr;
+    return slot->attachmentVerticesCount > 0 ? slot->attachmentVertices : att->super.vertices;
+}
+
+void boneAffine(const spBone* bone, float* m) {
+    m[0] = bone->a;
+    m[1] = bone->b;
+    m[2] = bone->c;
+    m[3] = bone->d;
+    m[4] = bone->worldX;
+    m[5] = bone->worldY;
+}
+
+void emptyBox(float* box) {
+    const SpineDrawList::Bounds empty;
+    box[0] = empty.minX;
+    box[1] = empty.minY;
+    box[2] = empty.maxX;
+    box[3] = empty.maxY;
+}
+}
+
+SpineDrawList::Bounds SpineDrawList::measure(spSkeleton* skeleton, FrameArena& arena) {
+    Bounds out;
+    if (!skeleton) return out;
+    for (int i = 0; i < skeleton->slotsCount; ++i) {
+        spSlot* slot = skeleton->drawOrder[i];
+        spAttachment* attachment = slot ? slot->attachment : nullptr;
+        if (!attachment) continue;
+
+        if (attachment->type == SP_ATTACHMENT_REGION) {
+            float* xy = arena.alloc<float>(8);
+            spRegionAttachment_computeWorldVertices((spRegionAttachment*)attachment, slot->bone, xy, 0, 2);
+            out.add(xy, 8);
+        } else if (attachment->type == SP_ATTACHMENT_MESH) {
+            spMeshAttachment* att = (spMeshAttachment*)attachment;
+            const int worldLen = att->super.worldVerticesLength;
+            float* xy = arena.alloc<float>((size_t)worldLen);
+            if (const float* local = unweightedVertices(att, slot)) {
+                float m[6];
+                boneAffine(slot->bone, m);
+                float box[4];
+                emptyBox(box);
+                SpineVertexKernels::active().transform(local, worldLen / 2, m, xy, box);
+                out.add(Bounds{box[0], box[1], box[2], box[3]});
+            } else {
+                spVertexAttachment_computeWorldVertices(&att->super, slot, 0, worldLen, xy, 0, 2);
+                out.add(xy, worldLen);
+            }
+        }
+    }
+    return out;
+}
+
+namespace {
+const float kNoDark[4] = {0.f, 0.f, 0.f, 0.f};
+
+inline quint16 unorm16(float v) { return quint16(qBound(0.f, v, 1.f) * 65535.f + 0.5f); }
+inline quint8 unorm8(float v) { return quint8(qBound(0.f, v, 1.f) * 255.f + 0.5f); }
+
+bool sameColor(const float* a, const float* b) {
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3];
+}
+
+void setBatchColors(SpineDrawList::Batch& batch, const float* color, const float* dark) {
+    for (int i = 0; i < 4; ++i) {
+        batch.color[i] = color[i];
+        batch.dark[i] = dark[i];
+    }
+}
+}
+
+int SpineDrawList::vertexStride(VertexFormat format) {
+    switch (format) {
+    case PackedVertex:     return int(sizeof(PackedVtx));
+    case BatchColorVertex: return int(sizeof(CompactVtx));
+    default:               return int(sizeof(Vtx));
+    }
+}
+
+int SpineDrawList::vertexCount() const {
+    switch (format) {
+    case PackedVertex:     return int(packedVerts.size());
+    case BatchColorVertex: return int(compactVerts.size());
+    default:               return int(verts.size());
+    }
+}
+
+const void* SpineDrawList::vertexData() const {
+    switch (format) {
+    case PackedVertex:     return packedVerts.data();
+    case BatchColorVertex: return compactVerts.data();
+    default:               return verts.data();
+    }
+}
+
+SpineDrawList::Capacities SpineDrawList::capacities() const {
+    return Capacities{verts.capacity() + packedVerts.capacity() + compactVerts.capacity(),
+                      indices.capacity(), indices32.capacity(), batches.capacity()};
+}
+
+// Vectors keep their capacity across frames; growth is a heap allocation.
+void SpineDrawList::countGrowth(const Capacities& before) {
+    const Capacities now = capacities();
+    heapAllocs += int(now.verts != before.verts)
+                + int(now.indices != before.indices)
+                + int(now.indices32 != before.indices32)
+                + int(now.batches != before.batches);
+}
+
+void SpineDrawList::append(const SpinePageTexture* page, int blendMode,
+                           const float* xy, const float* uv, int vertCount,
+                           const unsigned short* idx, int idxCount,
+                           const float* color, const float* dark)
+{
+    if (!dark) dark = kNoDark;
+
+    const Capacities before = capacities();
+    const size_t base = (size_t)vertexCount();
+    writeVertices(base, xy, uv, vertCount, color, dark);
+    commitSlot(page, blendMode, base, vertCount, idx, idxCount, color, dark);
+    countGrowth(before);
+}
+
+void SpineDrawList::writeVertices(size_t base, const float* xy, const float* uv, int vertCount,
+                                  const float* color, const float* dark)
+{
+    if (format == PackedVertex) {
+        // Colors are quantized once per slot, not per vertex.
+        PackedVtx proto{};
+        for (int i = 0; i < 4; ++i) {
+            proto.color[i] = unorm8(color[i]);
+            proto.dark[i] = unorm8(dark[i]);
+        }
+        packedVerts.resize(base + (size_t)vertCount);
+        PackedVtx* out = packedVerts.data() + base;
+        for (int v = 0; v < vertCount; ++v) {
+            out[v] = proto;
+            out[v].x = xy[v*2+0];
+            out[v].y = xy[v*2+1];
+            out[v].u = unorm16(uv[v*2+0]);
+            out[v].v = unorm16(uv[v*2+1]);
+        }
+    } else if (format == BatchColorVertex) {
+        compactVerts.resize(base + (size_t)vertCount);
+        CompactVtx* out = compactVerts.data() + base;
+        for (int v = 0; v < vertCount; ++v) {
+            out[v] = CompactVtx{ xy[v*2+0], xy[v*2+1], unorm16(uv[v*2+0]), unorm16(uv[v*2+1]) };
+        }
+    } else {
+        verts.resize(base + (size_t)vertCount);
+        SpineVertexKernels::active().interleave(xy, uv, vertCount, color, &verts[base].x);
+    }
+}
+
+SpineDrawList::Bounds SpineDrawList::appendAffine(const SpinePageTexture* page, int blendMode,
+                                                  const float* local, const float* uv, int vertCount,
+                                                  const float* m, const unsigned short* idx, int idxCount,
+                                                  const float* color, const Bounds& view, float minSize)
+{
+    const Capacities before = capacities();
+    const size_t base = verts.size();
+    verts.resize(base + (size_t)vertCount);
+
+    float box[4];
+    emptyBox(box);
+    SpineVertexKernels::active().transformInterleave(local, uv, vertCount, m, color, &verts[base].x, box);
+    const Bounds slotBounds{box[0], box[1], box[2], box[3]};
+
+    if (slotBounds.intersects(view) && !slotBounds.smallerThan(minSize)) commitSlot(page, blendMode, base, vertCount, idx, idxCount, color, kNoDark);
+    else verts.resize(base);
+    countGrowth(before);
+    return slotBounds;
+}
+
+// Batching and rebased indices for vertices already written at base.
+void SpineDrawList::commitSlot(const SpinePageTexture* page, int blendMode, size_t base, int vertCount,
+                               const unsigned short* idx, int idxCount,
+                               const float* color, const float* dark, BatchKind kind)
+{
+    // Past 65535 vertices the rebased indices no longer fit in 16 bits.
+    if (!wideIndices && base + (size_t)vertCount > 0x10000) {
+        indices32.assign(indices.begin(), indices.end());
+        indices.clear();
+        wideIndices = true;
+    }
+
+    QOpenGLTexture* tex = page ? page->texture : nullptr;
+    const SpineTextureArray* array = page ? page->array : nullptr;
+    const int layer = page ? page->layer : 0;
+    if (array && format == PackedVertex) {
+        for (size_t v = base; v < base + (size_t)vertCount; ++v) packedVerts[v].dark[3] = quint8(layer);
+    }
+
+    // Colors only split batches when they are uniforms, pool layers when the vertices
+    // do not carry them.
+    const bool colorBreak = format == BatchColorVertex && !batches.empty()
+        && (!sameColor(batches.back().color, color) || !sameColor(batches.back().dark, dark));
+    const bool layerBreak = format != PackedVertex && !batches.empty() && batches.back().layer != layer;
+    if (batches.empty() || kind != Draw || batches.back().kind != Draw || batches.back().skinned || colorBreak
+        || layerBreak || batches.back().tex != tex || batches.back().array != array
+        || batches.back().blendMode != blendMode) {
+        Batch batch;
+        batch.kind = kind;
+        batch.tex = tex;
+        batch.array = array;
+        batch.layer = layer;
+        batch.blendMode = blendMode;
+        batch.firstIndex = indexCount();
+        setBatchColors(batch, color, dark);
+        batches.push_back(batch);
+    }
+
+    if (wideIndices) {
+        const size_t first = indices32.size();
+        indices32.resize(first + (size_t)idxCount);
+        for (int ii = 0; ii < idxCount; ++ii) indices32[first + (size_t)ii] = quint32(base + idx[ii]);
+    } else {
+        const size_t first = indices.size();
+        indices.resize(first + (size_t)idxCount);
+        for (int ii = 0; ii < idxCount; ++ii) indices[first + (size_t)ii] = (unsigned short)(base + idx[ii]);
+    }
+    batches.back().indexCount += idxCount;
+    if (kind == Draw) ++slots;
+}
+
+int SpineDrawList::appendStencilClip(spSlot* slot, spClippingAttachment* clip, FrameArena& arena) {
+    const int worldLen = clip->super.worldVerticesLength;
+    const int n = worldLen / 2;
+    if (n < 3) return -1;
+
+    float* xy = arena.alloc<float>((size_t)worldLen);
+    spVertexAttachment_computeWorldVertices(&clip->super, slot, 0, worldLen, xy, 0, 2);
+    float* uv = arena.alloc<float>((size_t)worldLen);
+    std::fill(uv, uv + worldLen, 0.f);
+    unsigned short* fan = arena.alloc<unsigned short>(size_t(n - 2) * 3);
+    for (int i = 0; i < n - 2; ++i) {
+        fan[i*3+0] = 0;
+        fan[i*3+1] = (unsigned short)(i + 1);
+        fan[i*3+2] = (unsigned short)(i + 2);
+    }
+
+    const Capacities before = capacities();
+    const size_t base = (size_t)vertexCount();
+    writeVertices(base, xy, uv, n, kNoDark, kNoDark);
+    commitSlot(nullptr, 0, base, n, fan, (n - 2) * 3, kNoDark, kNoDark, ClipBegin);
+    countGrowth(before);
+    return int(batches.size()) - 1;
+}
+
+void SpineDrawList::appendSkinned(const SpinePageTexture* page, int blendMode, const SpineSkinnedMesh* mesh,
+                                  const float* color, const float* dark)
+{
+    const size_t batchCap = batches.capacity();
+    Batch batch;
+    batch.tex = page->texture;
+    batch.array = page->array;
+    batch.layer = page->layer;
+    batch.blendMode = blendMode;
+    batch.indexCount = int(mesh->indices.size());
+    batch.skinned = mesh;
+    setBatchColors(batch, color, dark ? dark : kNoDark);
+    batches.push_back(batch);
+
+    heapAllocs += int(batches.capacity() != batchCap);
+    ++slots;
+    ++skinnedSlots;
+}
+
+void SpineDrawList::build(spSkeleton* skeleton, spSkeletonClipping* clipper, FrameArena& arena,
+                          const Bounds& view, const SpineSkinnedMeshes* skinned, const Lod& lod)
+{
+    clear();
+    if (!skeleton || !clipper) return;
+
+    QElapsedTimer clock;
+    clock.start();
+
+    // Stencil mode tracks the open clip range itself; clipper is never started.
+    const spClippingAttachment* stencilClip = nullptr;
+    int stencilBegin = -1;
+    int stencilSlots = 0;   // slots before the open clip range
+    auto endStencilClip = [&] {
+        clippedSlots += slots - stencilSlots;
+        const size_t batchCap = batches.capacity();
+        Batch end = batches[(size_t)stencilBegin];
+        end.kind = ClipEnd;
+        batches.push_back(end);
+        heapAllocs += int(batches.capacity() != batchCap);
+        ++stencilClips;
+        stencilClip = nullptr;
+        stencilBegin = -1;
+    };
+    auto endSlot = [&](spSlot* slot) {
+        // This ends clipping when the clip's end slot is reached.
+        spSkeletonClipping_clipEnd(clipper, slot);
+        if (stencilClip && stencilClip->endSlot == slot->data) endStencilClip();
+    };
+
+    // Start with no clipping.
+    // Spine 3.6 recommends calling clipEnd2 at the end of the skeleton render.
+    for (int i = 0; i < skeleton->slotsCount; ++i) {
+        spSlot* slot = skeleton->drawOrder[i];
+        if (!slot) continue;
+
+        spAttachment* attachment = slot->attachment;
+
+        // Handle clipping start
+        if (attachment && attachment->type == SP_ATTACHMENT_CLIPPING) {
+            spClippingAttachment* clip = (spClippingAttachment*)attachment;
+            if (!stencilClipping) {
+                spSkeletonClipping_clipStart(clipper, slot, clip);
+            } else if (!stencilClip) {
+                // Like clipStart, a clip inside an open range is ignored.
+                stencilBegin = appendStencilClip(slot, clip, arena);
+                if (stencilBegin >= 0) stencilClip = clip;
+                stencilSlots = slots;
+            }
+            // clipStart slot itself does not draw.
+            endSlot(slot);
+            continue;
+        }
+
+        if (!attachment) {
+            endSlot(slot);
+            continue;
+        }
+
+        const float color[4] = {
+            skeleton->color.r * slot->color.r,
+            skeleton->color.g * slot->color.g,
+            skeleton->color.b * slot->color.b,
+            skeleton->color.a * slot->color.a
+        };
+        // Two-color tint; the float layout has no room for it and ignores it.
+        float darkColor[4] = {0.f, 0.f, 0.f, 0.f};
+        const float* dark = nullptr;
+        if (slot->darkColor) {
+            darkColor[0] = slot->darkColor->r;
+            darkColor[1] = slot->darkColor->g;
+            darkColor[2] = slot->darkColor->b;
+            darkColor[3] = 1.f;
+            dark = darkColor;
+        }
+        spAtlasRegion* region = nullptr;
+
+        // Base (unclipped) geometry: world positions come from the frame arena, UVs and
+        // triangles are read straight from the attachment.
+        float* baseXY = nullptr;
+        float* baseUV = nullptr;
+        unsigned short* baseIdx = nullptr;
+        int baseVertFloats = 0;
+        int baseIdxCount = 0;
+        Bounds affineBounds;            // from the transform kernel, which tracks it
+        bool haveAffineBounds = false;
+        const SpineLodMesh* lodMesh = nullptr;
+
+        if (attachment->type == SP_ATTACHMENT_REGION) {
+            spRegionAttachment* att = (spRegionAttachment*)attachment;
+
+            static unsigned short quadIdx[6] = {0,1,2, 2,3,0};
+
+            baseXY = arena.alloc<float>(8);
+            spRegionAttachment_computeWorldVertices(att, slot->bone, baseXY, 0, 2);
+            baseUV = att->uvs;
+            baseIdx = quadIdx;
+            baseVertFloats = 8;
+            baseIdxCount = 6;
+
+            region = (spAtlasRegion*)att->rendererObject;
+        } else if (attachment->type == SP_ATTACHMENT_MESH) {
+            spMeshAttachment* att = (spMeshAttachment*)attachment;
+            region = (spAtlasRegion*)att->rendererObject;
+
+            // Skinned in the vertex shader from static buffers. Clipping and deform keys
+            // change the geometry itself, so those frames go through the CPU path below.
+            const auto it = skinned ? skinned->find(attachment) : SpineSkinnedMeshes::const_iterator();
+            if (skinned && it != skinned->end() && slot->attachmentVerticesCount == 0
+                && !spSkeletonClipping_isClipping(clipper)
+                && region && region->page && region->page->rendererObject) {
+                const Bounds slotBounds = SpineSkinning::bounds(it->second, skeleton);
+                bounds.add(slotBounds);
+                if (!slotBounds.intersects(view)) {
+                    ++culledSlots;
+                } else if (slotBounds.smallerThan(lod.minSlotSize)) {
+                    ++lodSkippedSlots;
+                } else {
+                    const size_t boneCap = bones.capacity();
+                    if (bones.empty()) SpineSkinning::writeBones(skeleton, bones);
+                    heapAllocs += int(bones.capacity() != boneCap);
+                    appendSkinned(static_cast<const SpinePageTexture*>(region->page->rendererObject),
+                                  (int)slot->data->blendMode, &it->second, color, dark);
+                }
+                endSlot(slot);
+                continue;
+            }
+
+            int worldLen = att->super.worldVerticesLength; // floats count (x,y, x,y, ...)
+            baseUV = att->uvs;  // floats [u,v,...], same length as world vertices
+            baseIdx = att->triangles;
+            baseVertFloats = worldLen;
+            baseIdxCount = att->trianglesCount;
+
+            const auto lodIt = lod.meshes ? lod.meshes->find(attachment) : SpineLodMeshes::const_iterator();
+            if (lod.meshes && lodIt != lod.meshes->end()) lodMesh = &lodIt->second;
+
+            if (const float* local = unweightedVertices(att, slot)) {
+                // One bone affine over the whole mesh: the SIMD kernels do it. Without
+                // clipping the float layout takes the fused pass straight into verts.
+                float m[6];
+                boneAffine(slot->bone, m);
+                const bool clipping = spSkeletonClipping_isClipping(clipper) != 0;
+                if (!clipping && !lodMesh && format == FloatVertex && baseUV && worldLen >= 8 && baseIdxCount >= 3
+                    && region && region->page && region->page->rendererObject) {
+                    const Bounds slotBounds = appendAffine(
+                        static_cast<const SpinePageTexture*>(region->page->rendererObject), (int)slot->data->blendMode,
+                        local, baseUV, worldLen / 2, m, baseIdx, baseIdxCount, color, view, lod.minSlotSize);
+                    bounds.add(slotBounds);
+                    if (!slotBounds.intersects(view)) ++culledSlots;
+                    else if (slotBounds.smallerThan(lod.minSlotSize)) ++lodSkippedSlots;
+                    endSlot(slot);
+                    continue;
+                }
+                float box[4];
+                emptyBox(box);
+                baseXY = arena.alloc<float>((size_t)worldLen);
+                SpineVertexKernels::active().transform(local, worldLen / 2, m, baseXY, box);
+                affineBounds = Bounds{box[0], box[1], box[2], box[3]};
+                haveAffineBounds = true;
+            } else {
+                baseXY = arena.alloc<float>((size_t)worldLen);
+                spVertexAttachment_computeWorldVertices(&att->super, slot, 0, worldLen, baseXY, 0, 2);
+            }
+        } else {
+            endSlot(slot);
+            continue;
+        }
+
+        if (!region || !region->page || !region->page->rendererObject) {
+            endSlot(slot);
+            continue;
+        }
+
+        // Off-screen slots never reach clipping or the vertex streams. Clipping only
+        // shrinks geometry, so the unclipped box is a safe test.
+        Bounds slotBounds = affineBounds;
+        if (!haveAffineBounds) slotBounds.add(baseXY, baseVertFloats);
+        bounds.add(slotBounds);
+        if (!slotBounds.intersects(view)) {
+            ++culledSlots;
+            endSlot(slot);
+            continue;
+        }
+        if (slotBounds.smallerThan(lod.minSlotSize)) {
+            ++lodSkippedSlots;
+            endSlot(slot);
+            continue;
+        }
+        if (lodMesh) {
+            // Reduced triangle set over the vertices it still uses; the box above came
+            // from the full mesh.
+            const int n = (int)lodMesh->vertices.size();
+            float* xy = arena.alloc<float>(size_t(n) * 2);
+            float* uv = arena.alloc<float>(size_t(n) * 2);
+            for (int v = 0; v < n; ++v) {
+                const int src = lodMesh->vertices[(size_t)v];
+                xy[v*2+0] = baseXY[src*2+0];
+                xy[v*2+1] = baseXY[src*2+1];
+                uv[v*2+0] = baseUV[src*2+0];
+                uv[v*2+1] = baseUV[src*2+1];
+            }
+            baseXY = xy;
+            baseUV = uv;
+            baseIdx = const_cast<unsigned short*>(lodMesh->indices.data());   // spine-c only reads it
+            baseVertFloats = n * 2;
+            baseIdxCount = (int)lodMesh->indices.size();
+            ++lodMeshes;
+        }
+
+        // Apply clipping if active
+        const bool clipping = spSkeletonClipping_isClipping(clipper) != 0;
+
+        const float* finalXY = nullptr;
+        const float* finalUV = nullptr;
+        const unsigned short* finalIdx = nullptr;
+        int finalVertFloats = 0;
+        int finalIdxCount = 0;
+
+        if (clipping) {
+            const qint64 clipStart = clock.nsecsElapsed();
+            // clipTriangles writes to clipper->clippedVertices/UVs/Triangles
+            spSkeletonClipping_clipTriangles(
+                clipper,
+                baseXY, baseVertFloats,
+                baseIdx, baseIdxCount,
+                baseUV,
+                2 // stride in vertices array (x,y)
+            );
+
+            finalXY = clipper->clippedVertices->items;
+            finalUV = clipper->clippedUVs->items;
+            finalIdx = clipper->clippedTriangles->items;
+            finalVertFloats = clipper->clippedVertices->size; // floats count
+            finalIdxCount = clipper->clippedTriangles->size;  // indices count
+            clipNs += clock.nsecsElapsed() - clipStart;
+            ++clippedSlots;
+        } else {
+            finalXY = baseXY;
+            finalUV = baseUV;
+            finalIdx = baseIdx;
+            finalVertFloats = baseVertFloats;
+            finalIdxCount = baseIdxCount;
+        }
+
+        if (!finalXY || !finalUV || !finalIdx || finalVertFloats < 8 || finalIdxCount < 3) {
+            endSlot(slot);
+            continue;
+        }
+
+        auto* page = static_cast<const SpinePageTexture*>(region->page->rendererObject);
+
+        append(page, (int)slot->data->blendMode,
+               finalXY, finalUV, finalVertFloats / 2,
+               finalIdx, finalIdxCount,
+               color, dark);
+
+        endSlot(slot);
+    }
+
+    if (stencilClip) endStencilClip();
+    spSkeletonClipping_clipEnd2(clipper);
+    buildNs = clock.nsecsElapsed();
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include <QtGlobal>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#ifdef slots
+#  undef slots
+#endif
+#ifdef signals
+#  undef signals
+#endif
+#ifndef NOMINMAX
+#  define NOMINMAX
+#endif
+
+extern "C" {
+#include <spine/spine.h>
+#include <spine/SkeletonClipping.h>
+}
+
+class QOpenGLTexture;
+class SpineTextureArray;
+struct SpinePageTexture;
+class FrameArena;
+struct SpineSkinnedMesh;
+struct SpineLodMesh;
+
+// Per-skeleton GPU skinning data, keyed by mesh attachment (see spineskinning.h).
+using SpineSkinnedMeshes = std::unordered_map<const spAttachment*, SpineSkinnedMesh>;
+// Per-skeleton reduced meshes for far levels of detail, keyed the same way (see spinelod.h).
+using SpineLodMeshes = std::unordered_map<const spAttachment*, SpineLodMesh>;
+
+// CPU-side geometry for one skeleton, ready for upload.
+// Built without touching GL, so units can be tessellated on worker threads; the render
+// thread only uploads the streams and issues one draw per batch.
+struct SpineDrawList {
+    // Vertex layouts, switchable at runtime for A/B measurement. The compact ones store
+    // UVs as normalized 16-bit (atlas UVs are in 0..1) and support two-color tint.
+    enum VertexFormat {
+        FloatVertex,        // Vtx, 32 bytes: float position, UV and color
+        PackedVertex,       // PackedVtx, 20 bytes: RGBA8 light + dark color per vertex
+        BatchColorVertex,   // CompactVtx, 12 bytes: colors are per-batch uniforms
+        VertexFormatCount
+    };
+    struct Vtx { float x,y,u,v,r,g,b,a; };
+    struct PackedVtx { float x, y; quint16 u, v; quint8 color[4]; quint8 dark[4]; };
+    struct CompactVtx { float x, y; quint16 u, v; };
+    static int vertexStride(VertexFormat format);
+
+    // Axis-aligned box in skeleton space. Default-constructed boxes are empty.
+    struct Bounds {
+        float minX = std::numeric_limits<float>::infinity();
+        float minY = std::numeric_limits<float>::infinity();
+        float maxX = -std::numeric_limits<float>::infinity();
+        float maxY = -std::numeric_limits<float>::infinity();
+
+        static Bounds infinite() {
+            const float inf = std::numeric_limits<float>::infinity();
+            return Bounds{-inf, -inf, inf, inf};
+        }
+        bool isEmpty() const { return minX > maxX || minY > maxY; }
+        bool smallerThan(float size) const { return maxX - minX < size && maxY - minY < size; }
+        bool intersects(const Bounds& o) const {
+            return minX <= o.maxX && maxX >= o.minX && minY <= o.maxY && maxY >= o.minY;
+        }
+        void add(const Bounds& o);
+        void add(const float* xy, int floats);
+    };
+
+    // Stencil clipping: ClipBegin draws a clipping polygon as a triangle fan that inverts
+    // stencil bit 0 (even-odd fill, so concave polygons need no triangulation) and leaves
+    // the test on for the batches that follow; ClipEnd draws the same fan again, which
+    // clears the bit, and turns the test off.
+    enum BatchKind : quint8 { Draw, ClipBegin, ClipEnd };
+
+    // Consecutive slots sharing atlas page + blend mode (+ colors for BatchColorVertex),
+    // or one GPU-skinned mesh, or a stencil clip step. Skinned batches draw the mesh's own
+    // static buffers (firstIndex is 0 there) with this list's bone matrices. color / dark
+    // are the slot colors wherever the vertices do not carry them.
+    // In texture pool mode the page is a layer of array instead of tex; PackedVertex
+    // batches span layers (the vertices carry them), layer is then the first slot's.
+    struct Batch {
+        BatchKind kind = Draw;
+        QOpenGLTexture* tex = nullptr;
+        const SpineTextureArray* array = nullptr;
+        int layer = 0;
+        int blendMode = 0;
+        int firstIndex = 0;
+        int indexCount = 0;
+        const SpineSkinnedMesh* skinned = nullptr;
+        float color[4] = {1.f, 1.f, 1.f, 1.f};
+        float dark[4] = {0.f, 0.f, 0.f, 0.f};
+    };
+
+    // Level-of-detail options for build(): slots whose world box is under minSlotSize on
+    // both axes are skipped, and meshes found in meshes draw their reduced triangle set.
+    // Lod() (all zero) is full detail.
+    struct Lod {
+        float minSlotSize;
+        const SpineLodMeshes* meshes;
+    };
+
+    // Chosen by the caller before build(); clear() keeps it. Only the vector matching
+    // the format is filled.
+    VertexFormat format = FloatVertex;
+    // Also set by the caller: clipping attachments become stencil batches instead of
+    // going through spSkeletonClipping.
+    bool stencilClipping = false;
+    std::vector<Vtx> verts;
+    std::vector<PackedVtx> packedVerts;
+    std::vector<CompactVtx> compactVerts;
+    // Indices stay 16-bit until the list outgrows them, then widen to 32-bit.
+    std::vector<unsigned short> indices;
+    std::vector<quint32> indices32;
+    bool wideIndices = false;
+    std::vector<Batch> batches;
+    // Bone matrices for skinned batches (SpineSkinning::kFloatsPerBone each); empty when
+    // the list has none.
+    std::vector<float> bones;
+
+    int slots = 0;        // visible slots appended
+    int culledSlots = 0;  // slots outside the view, skipped before tessellation
+    int skinnedSlots = 0; // slots left to the vertex shader (counted in slots too)
+    int stencilClips = 0; // clip ranges emitted as ClipBegin/ClipEnd pairs
+    int clippedSlots = 0; // slots sent through clipTriangles, or drawn inside a stencil clip
+    int lodSkippedSlots = 0; // visible slots below Lod::minSlotSize
+    int lodMeshes = 0;    // meshes drawn with their reduced triangle set
+    int lodLevel = 0;     // set by the simulation after build(), like changedStep
+    bool culled = false;  // whole unit outside the view; nothing was built
+    Bounds bounds;        // every attachment of the skeleton, culled ones included
+    int heapAllocs = 0;   // vector growth while building (0 once warmed up)
+    // Sim step that last changed this unit's geometry; set by the simulation after
+    // build(), so the renderer can keep cached layers of units that stood still.
+    quint64 changedStep = 0;
+    // Time spent on this unit in the step that produced the list, ns. The simulation
+    // fills animateNs / worldNs; build() fills buildNs and clipNs (part of buildNs).
+    qint64 animateNs = 0;
+    qint64 worldNs = 0;
+    qint64 clipNs = 0;
+    qint64 buildNs = 0;
+
+    void clear();
+    int indexCount() const { return wideIndices ? (int)indices32.size() : (int)indices.size(); }
+    int vertexCount() const;
+    const void* vertexData() const;
+    int vertexBytes() const { return vertexCount() * vertexStride(format); }
+
+    // Tessellates every visible slot of an updated skeleton, clipping through clipper
+    // (or the stencil, see stencilClipping).
+    // Slots whose world AABB misses view are skipped. Scratch world vertices come from arena.
+    // Meshes found in skinned are emitted as skinned batches instead, unless they are
+    // clipped or deformed this frame. Skinned meshes keep their full triangle set at any lod.
+    void build(spSkeleton* skeleton, spSkeletonClipping* clipper, FrameArena& arena,
+               const Bounds& view = Bounds::infinite(),
+               const SpineSkinnedMeshes* skinned = nullptr,
+               const Lod& lod = Lod());
+
+    // World AABB of every region/mesh attachment, without tessellating anything.
+    static Bounds measure(spSkeleton* skeleton, FrameArena& arena);
+
+    // color is the light color (r, g, b, a); dark the two-color tint, nullptr for none.
+    void append(const SpinePageTexture* page, int blendMode,
+                const float* xy, const float* uv, int vertCount,
+                const unsigned short* idx, int idxCount,
+                const float* color, const float* dark = nullptr);
+    void appendSkinned(const SpinePageTexture* page, int blendMode, const SpineSkinnedMesh* mesh,
+                       const float* color, const float* dark = nullptr);
+
+    // FloatVertex only: bone affine m {a, b, c, d, worldX, worldY} of local vertices,
+    // interleaved and bounded in one kernel pass straight into verts. A slot that misses
+    // view, or is under minSize on both axes, is rolled back. Returns its world bounds.
+    Bounds appendAffine(const SpinePageTexture* page, int blendMode,
+                        const float* local, const float* uv, int vertCount, const float* m,
+                        const unsigned short* idx, int idxCount,
+                        const float* color, const Bounds& view, float minSize = 0.f);
+
+private:
+    struct Capacities { size_t verts, indices, indices32, batches; };
+    Capacities capacities() const;
+    void countGrowth(const Capacities& before);
+    void writeVertices(size_t base, const float* xy, const float* uv, int vertCount,
+                       const float* color, const float* dark);
+    void commitSlot(const SpinePageTexture* page, int blendMode, size_t base, int vertCount,
+                    const unsigned short* idx, int idxCount,
+                    const float* color, const float* dark, BatchKind kind = Draw);
+    // ClipBegin batch for clip's polygon; returns its index in batches, -1 if degenerate.
+    int appendStencilClip(spSlot* slot, spClippingAttachment* clip, FrameArena& arena);
+};
@@ -0,0 +1,366 @@
+#include "spinefastcache.h"
+#include "spineassetcache.h"
+#include "spinemappedfile.h"
+#include "spinetexturepool.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QImage>
+#include <QSaveFile>
+#include <QDebug>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+extern "C" {
+#include <spine/extension.h>
+}
+
+namespace {
+constexpr char kMagic[4] = { 'S', 'G', 'S', 'C' };
+constexpr quint32 kVersion = 1;
+constexpr quint64 kPixelAlign = 16;
+
+// On-disk layout: Header, PageRecord[pageCount], RegionRecord[regionCount], string table,
+// then each page's pixels (RGBA8888, tightly packed rows) at a 16-byte aligned offset.
+// Native endianness and packing; headerSize and the record sizes reject foreign files.
+struct Header {
+    char magic[4];
+    quint32 version;
+    quint32 headerSize;
+    quint32 pageRecordSize;
+    quint32 regionRecordSize;
+    quint32 pageCount;
+    quint32 regionCount;
+    quint32 stringBytes;
+    quint64 sourceHash;
+    quint64 pagesOffset;
+    quint64 regionsOffset;
+    quint64 stringsOffset;
+    quint64 fileSize;
+};
+
+struct PageRecord {
+    quint32 name;   // offset into the string table
+    qint32 format, minFilter, magFilter, uWrap, vWrap;
+    qint32 width, height;
+    quint64 pixels; // file offset of width * height * 4 bytes
+};
+
+struct RegionRecord {
+    quint32 name;
+    qint32 page;    // index into the page records
+    qint32 x, y, width, height;
+    float u, v, u2, v2;
+    qint32 offsetX, offsetY, originalWidth, originalHeight;
+    qint32 index, rotate, flip;
+    qint32 hasSplits, hasPads;
+    qint32 splits[4], pads[4];
+};
+
+static_assert(std::is_trivially_copyable<Header>::value, "Header is written raw");
+static_assert(std::is_trivially_copyable<PageRecord>::value, "PageRecord is written raw");
+static_assert(std::is_trivially_copyable<RegionRecord>::value, "RegionRecord is written raw");
+
+quint64 alignUp(quint64 v, quint64 a) { return (v + a - 1) & ~(a - 1); }
+
+// Keeps the cache mapping alive until the last page image referencing it is gone.
+void releaseMapping(void* info) {
+    delete static_cast<std::shared_ptr<SpineMappedFile>*>(info);
+}
+}
+
+bool SpineFastCache::enabled() {
+    return !cacheDir().isEmpty();
+}
+
+QString SpineFastCache::cacheDir() {
+    return qEnvironmentVariable("SGS_SPINE_CACHE_DIR");
+}
+
+QString SpineFastCache::cacheFile(const QString& atlasPath) {
+    // Canonical path, so "x.atlas" and "assets/x.atlas" share one file.
+    const QByteArray key = SpineAssetCache::canonicalPath(atlasPath).toUtf8();
+    const quint64 h = quint64(qHashBits(key.constData(), size_t(key.size())));
+    return QDir(cacheDir()).filePath(QFileInfo(atlasPath).completeBaseName()
+                                     + "-" + QString::number(h, 16) + ".sgsc");
+}
+
+QByteArray SpineFastCache::pageDir(const QString& atlasPath) {
+    const QByteArray utf8 = atlasPath.toUtf8();
+    qsizetype dirLength = qMax(utf8.lastIndexOf('/'), utf8.lastIndexOf('\\'));
+    if (dirLength == 0) dirLength = 1;
+    return dirLength > 0 ? utf8.left(dirLength) : QByteArray();
+}
+
+QByteArray SpineFastCache::pagePath(const QByteArray& dir, const char* name) {
+    QByteArray path = dir;
+    if (!path.isEmpty() && !path.endsWith('/') && !path.endsWith('\\')) path.append('/');
+    path.append(name);
+    return path;
+}
+
+bool SpineFastCache::sourceHash(const QString& atlasPath, const QByteArray& dir,
+                                const QList<QByteArray>& pageNames, quint64* hash) {
+    // qHashBits is only stable for one Qt build on one CPU; a changed result is a miss.
+    size_t h = kVersion;
+    auto mix = [&h](const QString& path) {
+        SpineMappedFile f(path);
+        if (!f.isOpen()) return false;
+        const qint64 size = f.size();
+        h = qHashBits(&size, sizeof(size), h);
+        h = qHashBits(f.data(), size_t(size), h);
+        return true;
+    };
+
+    if (!mix(atlasPath)) return false;
+    for (const QByteArray& name : pageNames) {
+        if (!mix(QString::fromUtf8(pagePath(dir, name.constData())))) return false;
+    }
+    *hash = quint64(h);
+    return true;
+}
+
+spAtlas* SpineFastCache::load(const QString& atlasPath, const QByteArray& dir) {
+    auto file = std::make_shared<SpineMappedFile>(cacheFile(atlasPath));
+    if (!file->isOpen()) return nullptr;
+
+    const char* base = file->data();
+    const quint64 size = quint64(file->size());
+    if (size < sizeof(Header)) return nullptr;
+
+    const Header* h = reinterpret_cast<const Header*>(base);
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->version != kVersion
+        || h->headerSize != sizeof(Header) || h->pageRecordSize != sizeof(PageRecord)
+        || h->regionRecordSize != sizeof(RegionRecord) || h->fileSize != size) {
+        qWarning() << "[SpineFastCache] ignoring incompatible cache:" << file->fileName();
+        return nullptr;
+    }
+    if (h->pagesOffset + quint64(h->pageCount) * sizeof(PageRecord) > size
+        || h->regionsOffset + quint64(h->regionCount) * sizeof(RegionRecord) > size
+        || h->stringsOffset + h->stringBytes > size
+        || h->stringBytes == 0 || base[h->stringsOffset + h->stringBytes - 1] != '\0') {
+        qWarning() << "[SpineFastCache] ignoring corrupt cache:" << file->fileName();
+        return nullptr;
+    }
+
+    const auto* pageRecs = reinterpret_cast<const PageRecord*>(base + h->pagesOffset);
+    const auto* regionRecs = reinterpret_cast<const RegionRecord*>(base + h->regionsOffset);
+    const char* strings = base + h->stringsOffset;
+
+    QList<QByteArray> pageNames;
+    for (quint32 i = 0; i < h->pageCount; ++i) {
+        const PageRecord& r = pageRecs[i];
+        if (r.name >= h->stringBytes || r.width <= 0 || r.height <= 0
+            || r.pixels + quint64(r.width) * quint64(r.height) * 4 > size) {
+            qWarning() << "[SpineFastCache] ignoring corrupt cache:" << file->fileName();
+            return nullptr;
+        }
+        pageNames.append(QByteArray(strings + r.name));
+    }
+    for (quint32 i = 0; i < h->regionCount; ++i) {
+        const RegionRecord& r = regionRecs[i];
+        if (r.name >= h->stringBytes || r.page < 0 || quint32(r.page) >= h->pageCount) {
+            qWarning() << "[SpineFastCache] ignoring corrupt cache:" << file->fileName();
+            return nullptr;
+        }
+    }
+
+    quint64 hash = 0;
+    if (!sourceHash(atlasPath, dir, pageNames, &hash) || hash != h->sourceHash) {
+        qWarning() << "[SpineFastCache] stale cache, reparsing:" << atlasPath;
+        return nullptr;
+    }
+
+    // Fix-up pass: offsets become spine-c objects (which own copies of the strings, so
+    // spAtlas_dispose works unchanged); pixels stay in the mapping until uploaded.
+    spAtlas* atlas = CALLOC(spAtlas, 1);
+
+    std::vector<spAtlasPage*> pages(h->pageCount, nullptr);
+    spAtlasPage* lastPage = nullptr;
+    for (quint32 i = 0; i < h->pageCount; ++i) {
+        const PageRecord& r = pageRecs[i];
+        spAtlasPage* page = spAtlasPage_create(atlas, strings + r.name);
+        page->format = spAtlasFormat(r.format);
+        page->minFilter = spAtlasFilter(r.minFilter);
+        page->magFilter = spAtlasFilter(r.magFilter);
+        page->uWrap = spAtlasWrap(r.uWrap);
+        page->vWrap = spAtlasWrap(r.vWrap);
+        page->width = r.width;
+        page->height = r.height;
+        if (lastPage) lastPage->next = page;
+        else atlas->pages = page;
+        lastPage = page;
+        pages[i] = page;
+    }
+
+    spAtlasRegion* lastRegion = nullptr;
+    for (quint32 i = 0; i < h->regionCount; ++i) {
+        const RegionRecord& r = regionRecs[i];
+        spAtlasRegion* region = spAtlasRegion_create();
+        MALLOC_STR(region->name, strings + r.name);
+        region->page = pages[size_t(r.page)];
+        region->x = r.x;
+        region->y = r.y;
+        region->width = r.width;
+        region->height = r.height;
+        region->u = r.u;
+        region->v = r.v;
+        region->u2 = r.u2;
+        region->v2 = r.v2;
+        region->offsetX = r.offsetX;
+        region->offsetY = r.offsetY;
+        region->originalWidth = r.originalWidth;
+        region->originalHeight = r.originalHeight;
+        region->index = r.index;
+        region->rotate = r.rotate;
+        region->flip = r.flip;
+        if (r.hasSplits) {
+            region->splits = MALLOC(int, 4);
+            std::memcpy(region->splits, r.splits, sizeof(r.splits));
+        }
+        if (r.hasPads) {
+            region->pads = MALLOC(int, 4);
+            std::memcpy(region->pads, r.pads, sizeof(r.pads));
+        }
+        if (lastRegion) lastRegion->next = region;
+        else atlas->regions = region;
+        lastRegion = region;
+    }
+
+    // Same hand-off as _spAtlasPage_createTexture, minus the decode.
+    for (quint32 i = 0; i < h->pageCount; ++i) {
+        const PageRecord& r = pageRecs[i];
+        QImage image(reinterpret_cast<const uchar*>(base + r.pixels), r.width, r.height,
+                     qsizetype(r.width) * 4, QImage::Format_RGBA8888,
+                     releaseMapping, new std::shared_ptr<SpineMappedFile>(file));
+        pages[i]->rendererObject = new SpinePageTexture;
+        SpineAssetCache::instance().queueUpload(pages[i], image);
+    }
+
+    return atlas;
+}
+
+bool SpineFastCache::store(const QString& atlasPath, const QByteArray& dir, const spAtlas* atlas) {
+    QByteArray strings;
+    auto addString = [&strings](const char* s) {
+        const quint32 offset = quint32(strings.size());
+        strings.append(s, qsizetype(std::strlen(s)) + 1);
+        return offset;
+    };
+
+    std::vector<PageRecord> pages;
+    std::vector<QImage> images;
+    QList<QByteArray> pageNames;
+    QHash<const spAtlasPage*, int> pageIndex;
+    for (const spAtlasPage* page = atlas->pages; page; page = page->next) {
+        const QImage image = SpineAssetCache::instance().pendingImage(page);
+        if (image.isNull() || image.format() != QImage::Format_RGBA8888) return false;
+
+        PageRecord r{};
+        r.name = addString(page->name);
+        r.format = page->format;
+        r.minFilter = page->minFilter;
+        r.magFilter = page->magFilter;
+        r.uWrap = page->uWrap;
+        r.vWrap = page->vWrap;
+        r.width = image.width();
+        r.height = image.height();
+        pageIndex.insert(page, int(pages.size()));
+        pages.push_back(r);
+        images.push_back(image);
+        pageNames.append(QByteArray(page->name));
+    }
+
+    std::vector<RegionRecord> regions;
+    for (const spAtlasRegion* region = atlas->regions; region; region = region->next) {
+        RegionRecord r{};
+        r.name = addString(region->name);
+        r.page = pageIndex.value(region->page, -1);
+        if (r.page < 0) return false;
+        r.x = region->x;
+        r.y = region->y;
+        r.width = region->width;
+        r.height = region->height;
+        r.u = region->u;
+        r.v = region->v;
+        r.u2 = region->u2;
+        r.v2 = region->v2;
+        r.offsetX = region->offsetX;
+        r.offsetY = region->offsetY;
+        r.originalWidth = region->originalWidth;
+        r.originalHeight = region->originalHeight;
+        r.index = region->index;
+        r.rotate = region->rotate;
+        r.flip = region->flip;
+        if (region->splits) {
+            r.hasSplits = 1;
+            std::memcpy(r.splits, region->splits, sizeof(r.splits));
+        }
+        if (region->pads) {
+            r.hasPads = 1;
+            std::memcpy(r.pads, region->pads, sizeof(r.pads));
+        }
+        regions.push_back(r);
+    }
+    if (strings.isEmpty()) addString("");
+
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.headerSize = sizeof(Header);
+    h.pageRecordSize = sizeof(PageRecord);
+    h.regionRecordSize = sizeof(RegionRecord);
+    h.pageCount = quint32(pages.size());
+    h.regionCount = quint32(regions.size());
+    h.stringBytes = quint32(strings.size());
+    if (!sourceHash(atlasPath, dir, pageNames, &h.sourceHash)) return false;
+
+    quint64 offset = sizeof(Header);
+    h.pagesOffset = offset;
+    offset += pages.size() * sizeof(PageRecord);
+    h.regionsOffset = offset;
+    offset += regions.size() * sizeof(RegionRecord);
+    h.stringsOffset = offset;
+    offset += quint64(strings.size());
+    for (auto& r : pages) {
+        offset = alignUp(offset, kPixelAlign);
+        r.pixels = offset;
+        offset += quint64(r.width) * quint64(r.height) * 4;
+    }
+    h.fileSize = offset;
+
+    QDir().mkpath(cacheDir());
+    const QString path = cacheFile(atlasPath);
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qWarning() << "[SpineFastCache] cannot write cache:" << path << out.errorString();
+        return false;
+    }
+
+    quint64 written = 0;
+    auto put = [&out, &written](const void* data, quint64 bytes) {
+        out.write(static_cast<const char*>(data), qint64(bytes));
+        written += bytes;
+    };
+    put(&h, sizeof(h));
+    put(pages.data(), pages.size() * sizeof(PageRecord));
+    put(regions.data(), regions.size() * sizeof(RegionRecord));
+    put(strings.constData(), quint64(strings.size()));
+    static const char zeros[kPixelAlign] = {};
+    for (size_t i = 0; i < pages.size(); ++i) {
+        put(zeros, pages[i].pixels - written);
+        const QImage& image = images[i];
+        const quint64 rowBytes = quint64(image.width()) * 4;
+        for (int y = 0; y < image.height(); ++y) put(image.constScanLine(y), rowBytes);
+    }
+
+    if (!out.commit()) {
+        qWarning() << "[SpineFastCache] cannot write cache:" << path << out.errorString();
+        return false;
+    }
+    qDebug() << "[SpineFastCache] wrote" << path << "bytes:" << written;
+    return true;
+}
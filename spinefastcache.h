@@ -0,0 +1,51 @@
+#pragma once
+#include <QString>
+#include <QByteArray>
+
+#ifdef slots
+#  undef slots
+#endif
+#ifdef signals
+#  undef signals
+#endif
+#ifndef NOMINMAX
+#  define NOMINMAX
+#endif
+
+extern "C" {
+#include <spine/spine.h>
+}
+
+// Optional precompiled atlas cache, enabled by setting SGS_SPINE_CACHE_DIR.
+//
+// One file per .atlas holds the parsed page/region tables plus every page already
+// decoded to RGBA8888, so a warm start skips both the atlas text parse and PNG decode.
+// Loading is one mmap and a fix-up pass: table offsets become spine-c objects and the
+// page pixels are queued for upload straight out of the mapping.
+//
+// The file is tagged with a hash of the .atlas text and of every page image it names;
+// any mismatch (or a corrupt / foreign-version file) reads as a miss and the caller
+// falls back to spine-c. The cache is written on the first miss.
+class SpineFastCache {
+public:
+    static bool enabled();
+    static QString cacheDir();
+    static QString cacheFile(const QString& atlasPath);
+
+    // Loader thread. dir is the page directory spine-c would use for atlasPath.
+    // Returns nullptr on a miss; on a hit the pages are already queued on SpineAssetCache.
+    static spAtlas* load(const QString& atlasPath, const QByteArray& dir);
+
+    // Loader thread, right after spAtlas_create and before the pages are uploaded (the
+    // decoded pixels are read back from SpineAssetCache's upload queue).
+    static bool store(const QString& atlasPath, const QByteArray& dir, const spAtlas* atlas);
+
+    // spine-c resolves page names against this directory: the atlas path up to its last
+    // slash, never dropping a leading one.
+    static QByteArray pageDir(const QString& atlasPath);
+
+private:
+    static QByteArray pagePath(const QByteArray& dir, const char* name);
+    static bool sourceHash(const QString& atlasPath, const QByteArray& dir,
+                           const QList<QByteArray>& pageNames, quint64* hash);
+};
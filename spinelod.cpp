@@ -0,0 +1,132 @@
+#include "spinelod.h"
+
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+namespace {
+// Meshes with fewer triangles are left alone; there is nothing worth saving.
+constexpr int kMinTriangles = 8;
+// Interior vertices per grid cell the reduction aims for.
+constexpr double kVerticesPerCell = 4.0;
+
+bool simplify(const spMeshAttachment* att, SpineLodMesh& out) {
+    const int vertexCount = att->super.worldVerticesLength / 2;
+    const int triangleCount = att->trianglesCount / 3;
+    if (!att->uvs || !att->triangles || triangleCount < kMinTriangles || vertexCount > 0x10000) return false;
+    const int hull = qBound(0, att->hullLength / 2, vertexCount);
+    if (vertexCount - hull < 2) return false;
+
+    float minU = 1.f, minV = 1.f, maxU = 0.f, maxV = 0.f;
+    for (int i = hull; i < vertexCount; ++i) {
+        minU = qMin(minU, att->uvs[i*2+0]);
+        maxU = qMax(maxU, att->uvs[i*2+0]);
+        minV = qMin(minV, att->uvs[i*2+1]);
+        maxV = qMax(maxV, att->uvs[i*2+1]);
+    }
+    const int cells = qMax(2, int(std::ceil(std::sqrt(double(vertexCount - hull) / kVerticesPerCell))));
+    const float spanU = qMax(maxU - minU, 1e-6f);
+    const float spanV = qMax(maxV - minV, 1e-6f);
+
+    // Each interior vertex collapses onto the first interior vertex of its cell.
+    std::vector<int> rep((size_t)vertexCount);
+    std::vector<int> cellRep(size_t(cells * cells), -1);
+    for (int i = 0; i < vertexCount; ++i) {
+        if (i < hull) {
+            rep[(size_t)i] = i;
+            continue;
+        }
+        const int cx = qBound(0, int((att->uvs[i*2+0] - minU) / spanU * float(cells)), cells - 1);
+        const int cy = qBound(0, int((att->uvs[i*2+1] - minV) / spanV * float(cells)), cells - 1);
+        int& cell = cellRep[size_t(cy * cells + cx)];
+        if (cell < 0) cell = i;
+        rep[(size_t)i] = cell;
+    }
+
+    std::vector<int> kept((size_t)vertexCount, -1);
+    std::unordered_set<quint64> seen;
+    for (int t = 0; t < triangleCount; ++t) {
+        int v[3];
+        for (int k = 0; k < 3; ++k) v[k] = rep[att->triangles[t*3+k]];
+        if (v[0] == v[1] || v[1] == v[2] || v[0] == v[2]) continue;
+
+        int key[3] = {v[0], v[1], v[2]};
+        std::sort(key, key + 3);
+        if (!seen.insert(quint64(key[0]) << 32 | quint64(key[1]) << 16 | quint64(key[2])).second) continue;
+
+        // Original winding; only the corners move.
+        for (int k = 0; k < 3; ++k) {
+            int& index = kept[(size_t)v[k]];
+            if (index < 0) {
+                index = int(out.vertices.size());
+                out.vertices.push_back((unsigned short)v[k]);
+            }
+            out.indices.push_back((unsigned short)index);
+        }
+    }
+    return out.indices.size() * 4 <= size_t(att->trianglesCount) * 3;
+}
+
+void collect(const spSkeletonData* data, const spSkin* skin, SpineLodMeshes& out) {
+    if (!skin) return;
+    for (int slot = 0; slot < data->slotsCount; ++slot) {
+        for (int i = 0;; ++i) {
+            const char* name = spSkin_getAttachmentName(skin, slot, i);
+            if (!name) break;
+            const spAttachment* a = spSkin_getAttachment(skin, slot, name);
+            if (!a || a->type != SP_ATTACHMENT_MESH || out.count(a)) continue;
+
+            SpineLodMesh mesh;
+            if (simplify(reinterpret_cast<const spMeshAttachment*>(a), mesh)) out.emplace(a, std::move(mesh));
+        }
+    }
+}
+}
+
+SpineLodMeshes SpineLod::prepare(const spSkeletonData* data) {
+    SpineLodMeshes out;
+    if (!data) return out;
+    collect(data, data->defaultSkin, out);
+    for (int i = 0; i < data->skinsCount; ++i) collect(data, data->skins[i], out);
+    return out;
+}
+
+int SpineLod::level(float size, const float* sizes, int current) {
+    int level = 0;
+    for (int i = 0; i < kLevels - 1 && sizes[i] > 0.f; ++i) {
+        const float limit = current > i ? sizes[i] * kHysteresis : sizes[i];
+        if (size < limit) level = i + 1;
+    }
+    return level;
+}
+
+void SpineLod::capturePose(const spSkeleton* skeleton, std::vector<float>& out) {
+    out.resize(size_t(skeleton->bonesCount) * 6);
+    float* dst = out.data();
+    for (int i = 0; i < skeleton->bonesCount; ++i, dst += 6) {
+        const spBone* bone = skeleton->bones[i];
+        dst[0] = bone->a;
+        dst[1] = bone->b;
+        dst[2] = bone->c;
+        dst[3] = bone->d;
+        dst[4] = bone->worldX;
+        dst[5] = bone->worldY;
+    }
+}
+
+void SpineLod::blendPose(spSkeleton* skeleton, const std::vector<float>& from,
+                         const std::vector<float>& to, float t) {
+    const size_t n = size_t(skeleton->bonesCount) * 6;
+    if (from.size() < n || to.size() < n) return;
+    for (int i = 0; i < skeleton->bonesCount; ++i) {
+        // World fields are const in the spine-c headers; only updateWorldTransform writes them.
+        spBone* bone = skeleton->bones[i];
+        float* dst[6] = {const_cast<float*>(&bone->a), const_cast<float*>(&bone->b),
+                         const_cast<float*>(&bone->c), const_cast<float*>(&bone->d),
+                         const_cast<float*>(&bone->worldX), const_cast<float*>(&bone->worldY)};
+        const float* a = from.data() + size_t(i) * 6;
+        const float* b = to.data() + size_t(i) * 6;
+        for (int k = 0; k < 6; ++k) *dst[k] = a[k] + (b[k] - a[k]) * t;
+    }
+}
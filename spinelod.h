@@ -0,0 +1,47 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+
+#include "spinedrawlist.h"
+
+// Load-time reduced version of one mesh attachment for the far level of detail: interior
+// vertices are merged on a coarse UV grid (the hull is kept, so the outline does not
+// move), triangles that collapse or repeat are dropped, and only the vertices still
+// referenced are kept.
+struct SpineLodMesh {
+    std::vector<unsigned short> vertices;   // attachment vertex index of each kept vertex
+    std::vector<unsigned short> indices;    // triangles over the kept vertices
+};
+
+// Level-of-detail policy. A unit with LOD sizes (config "lod") picks its level from the
+// larger side of its on-screen bounds each step:
+//   0  full detail;
+//   1  pose evaluated at a reduced rate, bone transforms interpolated in between, slots
+//      under kMinSlotSize[1] pixels skipped;
+//   2  lower rate again, larger slot threshold, and meshes drawn from their SpineLodMesh.
+class SpineLod {
+public:
+    static constexpr int kLevels = 3;
+    static constexpr int kMeshLevel = 2;
+    static constexpr float kMinSlotSize[kLevels] = {0.f, 2.f, 4.f};
+    // Pose rates (Hz) of levels 1 and 2 when the unit config has no "lodRates".
+    static constexpr float kDefaultRates[kLevels - 1] = {20.f, 10.f};
+    // A unit leaves a level only once it is this much larger than the level's size, so
+    // one sitting on a boundary does not flip every step.
+    static constexpr float kHysteresis = 1.15f;
+
+    // Loader thread: a reduced mesh for every mesh attachment of every skin that loses
+    // at least a quarter of its triangles.
+    static SpineLodMeshes prepare(const spSkeletonData* data);
+
+    // sizes[i]: on-screen size in pixels below which a unit is at level i + 1 or more,
+    // descending; 0 ends the list. current is the unit's level at the last step.
+    static int level(float size, const float* sizes, int current);
+
+    // World transform {a, b, c, d, worldX, worldY} of every bone, resized to fit.
+    static void capturePose(const spSkeleton* skeleton, std::vector<float>& out);
+    // Writes the linear blend of two captured poses into the bones' world transforms, in
+    // place of spSkeleton_updateWorldTransform.
+    static void blendPose(spSkeleton* skeleton, const std::vector<float>& from,
+                          const std::vector<float>& to, float t);
+};
@@ -0,0 +1,35 @@
+#include "spinemappedfile.h"
+
+bool SpineMappedFile::open(const QString& path) {
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.exists()) m_file.setFileName("assets/" + path);
+    if (!m_file.open(QIODevice::ReadOnly)) return false;
+
+    const qint64 size = m_file.size();
+    if (size <= 0 || size > 0x7fffffff) {
+        m_file.close();
+        return false;
+    }
+
+    m_data = m_file.map(0, size);
+    if (m_data) {
+        m_mapped = true;
+    } else {
+        // Some file systems / resource entries cannot be mapped.
+        m_fallback = m_file.readAll();
+        m_data = reinterpret_cast<const uchar*>(m_fallback.constData());
+    }
+    m_size = int(size);
+    return true;
+}
+
+void SpineMappedFile::close() {
+    if (m_mapped) m_file.unmap(const_cast<uchar*>(m_data));
+    if (m_file.isOpen()) m_file.close();
+    m_fallback = QByteArray();
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+}
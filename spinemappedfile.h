@@ -0,0 +1,33 @@
+#pragma once
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+
+// Read-only view of a whole asset file, memory-mapped when possible.
+// Looks the path up as given, then under assets/ (same order as _spUtil_readFile).
+// The view stays valid until the object is destroyed, so keep it scoped to the parse.
+class SpineMappedFile {
+public:
+    SpineMappedFile() = default;
+    explicit SpineMappedFile(const QString& path) { open(path); }
+    ~SpineMappedFile() { close(); }
+
+    SpineMappedFile(const SpineMappedFile&) = delete;
+    SpineMappedFile& operator=(const SpineMappedFile&) = delete;
+
+    bool open(const QString& path);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const char* data() const { return reinterpret_cast<const char*>(m_data); }
+    int size() const { return m_size; }
+    bool isMapped() const { return m_mapped; }
+    QString fileName() const { return m_file.fileName(); }
+
+private:
+    QFile m_file;
+    const uchar* m_data = nullptr;
+    int m_size = 0;
+    bool m_mapped = false;
+    QByteArray m_fallback;   // only used when the file cannot be mapped
+};
@@ -0,0 +1,264 @@
+#include "spineperfcounters.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOpenGLContext>
+#include <algorithm>
+
+#ifndef GL_TIME_ELAPSED
+#  define GL_TIME_ELAPSED 0x88BF
+#endif
+
+namespace {
+QVariantMap timeStats(std::vector<double> ms) {
+    QVariantMap m;
+    if (ms.empty()) return m;
+    std::sort(ms.begin(), ms.end());
+    double sum = 0.0;
+    for (double v : ms) sum += v;
+    m.insert("mean", sum / double(ms.size()));
+    m.insert("p95", ms[std::min(ms.size() - 1, ms.size() * 95 / 100)]);
+    m.insert("max", ms.back());
+    return m;
+}
+
+QVariantMap counterStats(const std::vector<double>& values) {
+    QVariantMap m;
+    if (values.empty()) return m;
+    double sum = 0.0;
+    for (double v : values) sum += v;
+    m.insert("mean", sum / double(values.size()));
+    m.insert("max", *std::max_element(values.begin(), values.end()));
+    return m;
+}
+
+enum TraceThread { RenderThread = 1, SimThread = 2, GpuTimeline = 3 };
+
+QJsonObject span(const char* name, TraceThread tid, qint64 startNs, qint64 durNs) {
+    QJsonObject e;
+    e.insert("name", name);
+    e.insert("ph", "X");
+    e.insert("pid", 1);
+    e.insert("tid", int(tid));
+    e.insert("ts", double(startNs) / 1e3);
+    e.insert("dur", double(durNs) / 1e3);
+    return e;
+}
+
+QJsonObject threadName(TraceThread tid, const char* name) {
+    QJsonObject args;
+    args.insert("name", name);
+    QJsonObject e;
+    e.insert("name", "thread_name");
+    e.insert("ph", "M");
+    e.insert("pid", 1);
+    e.insert("tid", int(tid));
+    e.insert("args", args);
+    return e;
+}
+}
+
+SpinePerfCounters::SpinePerfCounters() {
+    m_clock.start();
+}
+
+void SpinePerfCounters::setEnabled(bool on) {
+    if (m_enabled == on) return;
+    m_enabled = on;
+    // A restarted window must not mix in frames from before the pause.
+    m_count = 0;
+    m_next = 0;
+    m_fresh = 0;
+}
+
+void SpinePerfCounters::setWindow(int frames) {
+    frames = qMax(1, frames);
+    if (frames == m_window) return;
+    m_window = frames;
+    m_frames.clear();
+    m_count = 0;
+    m_next = 0;
+    m_fresh = 0;
+}
+
+void SpinePerfCounters::record(const Frame& frame) {
+    if (m_frames.size() != size_t(m_window)) m_frames.resize(size_t(m_window));
+    m_frames[m_next] = frame;
+    m_next = (m_next + 1) % m_frames.size();
+    m_count = std::min(m_count + 1, m_frames.size());
+    ++m_fresh;
+}
+
+std::vector<const SpinePerfCounters::Frame*> SpinePerfCounters::ordered() const {
+    std::vector<const Frame*> out;
+    out.reserve(m_count);
+    const size_t first = (m_next + m_frames.size() - m_count) % qMax<size_t>(1, m_frames.size());
+    for (size_t i = 0; i < m_count; ++i) out.push_back(&m_frames[(first + i) % m_frames.size()]);
+    return out;
+}
+
+void SpinePerfCounters::beginGpu(QOpenGLExtraFunctions* gl, quint64 frame) {
+    if (!m_gpuChecked) {
+        m_gpuChecked = true;
+        // GL_TIME_ELAPSED is core since 3.3; GLES only has it as an extension.
+        QOpenGLContext* ctx = QOpenGLContext::currentContext();
+        m_gpuSupported = ctx && !ctx->isOpenGLES();
+        if (m_gpuSupported) {
+            GLuint ids[kQueries];
+            gl->glGenQueries(kQueries, ids);
+            for (int i = 0; i < kQueries; ++i) m_queries[i].id = ids[i];
+        } else {
+            qWarning() << "[SpinePerfCounters] no GL timer queries on this context; gpu times stay empty";
+        }
+    }
+    if (!m_gpuSupported) return;
+
+    collectGpu(gl);
+    Query& q = m_queries[m_nextQuery];
+    if (q.pending) return;   // GPU more than kQueries frames behind; this frame goes untimed
+    gl->glBeginQuery(GL_TIME_ELAPSED, q.id);
+    q.frame = frame;
+    q.pending = true;
+    m_activeQuery = m_nextQuery;
+    m_nextQuery = (m_nextQuery + 1) % kQueries;
+}
+
+void SpinePerfCounters::endGpu(QOpenGLExtraFunctions* gl) {
+    if (m_activeQuery < 0) return;
+    gl->glEndQuery(GL_TIME_ELAPSED);
+    m_activeQuery = -1;
+}
+
+void SpinePerfCounters::collectGpu(QOpenGLExtraFunctions* gl) {
+    for (Query& q : m_queries) {
+        if (!q.pending) continue;
+        GLuint available = 0;
+        gl->glGetQueryObjectuiv(q.id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        GLuint ns = 0;
+        gl->glGetQueryObjectuiv(q.id, GL_QUERY_RESULT, &ns);
+        q.pending = false;
+        for (Frame& f : m_frames) {
+            if (f.index == q.frame) f.gpuNs = qint64(ns);
+        }
+    }
+}
+
+void SpinePerfCounters::releaseGl(QOpenGLExtraFunctions* gl) {
+    if (!m_gpuSupported) return;
+    if (m_activeQuery >= 0) endGpu(gl);
+    GLuint ids[kQueries];
+    for (int i = 0; i < kQueries; ++i) {
+        ids[i] = m_queries[i].id;
+        m_queries[i] = Query{};
+    }
+    gl->glDeleteQueries(kQueries, ids);
+    m_gpuChecked = false;
+    m_gpuSupported = false;
+}
+
+QVariantMap SpinePerfCounters::aggregate() {
+    m_fresh = 0;
+    const auto frames = ordered();
+
+    std::vector<double> cpu, textures, animate, world, clip, build, upload, submit, gpu;
+    std::vector<double> draws, verts, idx, texBinds, blends, clipped, lodSkipped, bytes, baked;
+    for (const Frame* f : frames) {
+        cpu.push_back(f->cpuNs / 1e6);
+        textures.push_back(f->texturesNs / 1e6);
+        animate.push_back(f->animateNs / 1e6);
+        world.push_back(f->worldNs / 1e6);
+        clip.push_back(f->clipNs / 1e6);
+        build.push_back((f->buildNs - f->clipNs) / 1e6);
+        upload.push_back(f->uploadNs / 1e6);
+        submit.push_back(f->submitNs / 1e6);
+        if (f->gpuNs >= 0) gpu.push_back(f->gpuNs / 1e6);
+        draws.push_back(f->drawCalls);
+        verts.push_back(f->vertices);
+        idx.push_back(f->indices);
+        texBinds.push_back(f->textureBinds);
+        blends.push_back(f->blendSwitches);
+        clipped.push_back(f->clippedSlots);
+        lodSkipped.push_back(f->lodSkippedSlots);
+        bytes.push_back(f->uploadBytes);
+        baked.push_back(double(f->bakedBytes));
+    }
+
+    QVariantMap m;
+    m.insert("frames", int(frames.size()));
+    m.insert("window", m_window);
+    m.insert("gpuFrames", int(gpu.size()));
+    m.insert("cpuMs", timeStats(cpu));
+    m.insert("texturesMs", timeStats(textures));
+    m.insert("animationMs", timeStats(animate));
+    m.insert("worldTransformMs", timeStats(world));
+    m.insert("clippingMs", timeStats(clip));
+    m.insert("vertexBuildMs", timeStats(build));
+    m.insert("uploadMs", timeStats(upload));
+    m.insert("submitMs", timeStats(submit));
+    m.insert("gpuMs", timeStats(gpu));
+    m.insert("drawCalls", counterStats(draws));
+    m.insert("vertices", counterStats(verts));
+    m.insert("indices", counterStats(idx));
+    m.insert("textureBinds", counterStats(texBinds));
+    m.insert("blendSwitches", counterStats(blends));
+    m.insert("clippedSlots", counterStats(clipped));
+    m.insert("lodSkippedSlots", counterStats(lodSkipped));
+    m.insert("uploadBytes", counterStats(bytes));
+    m.insert("bakedBytes", counterStats(baked));
+    return m;
+}
+
+bool SpinePerfCounters::writeChromeTrace(const QString& path) const {
+    QJsonArray events;
+    events.append(threadName(RenderThread, "render"));
+    events.append(threadName(SimThread, "simulation (summed per unit)"));
+    events.append(threadName(GpuTimeline, "gpu"));
+
+    for (const Frame* f : ordered()) {
+        QJsonObject args;
+        args.insert("frame", qint64(f->index));
+        args.insert("drawCalls", f->drawCalls);
+        args.insert("vertices", f->vertices);
+        args.insert("indices", f->indices);
+        args.insert("textureBinds", f->textureBinds);
+        args.insert("blendSwitches", f->blendSwitches);
+        args.insert("clippedSlots", f->clippedSlots);
+        args.insert("lodSkippedSlots", f->lodSkippedSlots);
+        args.insert("uploadBytes", f->uploadBytes);
+        QJsonObject frame = span("frame", RenderThread, f->startNs, f->cpuNs);
+        frame.insert("args", args);
+        events.append(frame);
+
+        qint64 t = f->startNs;
+        events.append(span("textures", RenderThread, t, f->texturesNs));
+        t += f->texturesNs;
+        if (f->gpuNs >= 0) events.append(span("gpu", GpuTimeline, t, f->gpuNs));
+        events.append(span("upload", RenderThread, t, f->uploadNs));
+        t += f->uploadNs;
+        events.append(span("submit", RenderThread, t, f->submitNs));
+
+        t = f->startNs - (f->animateNs + f->worldNs + f->buildNs);
+        events.append(span("animation", SimThread, t, f->animateNs));
+        t += f->animateNs;
+        events.append(span("worldTransform", SimThread, t, f->worldNs));
+        t += f->worldNs;
+        events.append(span("vertexBuild", SimThread, t, f->buildNs));
+        if (f->clipNs > 0) events.append(span("clipping", SimThread, t, f->clipNs));
+    }
+
+    QJsonObject root;
+    root.insert("traceEvents", events);
+    root.insert("displayTimeUnit", "ms");
+
+    QFile file(path);
+    const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+        qWarning() << "[SpinePerfCounters] cannot write trace" << path;
+        return false;
+    }
+    return true;
+}
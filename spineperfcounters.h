@@ -0,0 +1,86 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QOpenGLExtraFunctions>
+#include <QString>
+#include <QVariantMap>
+#include <vector>
+
+// Render-thread instrumentation for SpineRenderer: a rolling window of per-frame
+// records, GL_TIME_ELAPSED queries for the GPU side and a Chrome trace dump.
+// Nothing here runs while disabled; the renderer only checks enabled() once per frame.
+class SpinePerfCounters {
+public:
+    struct Frame {
+        quint64 index = 0;
+        qint64 startNs = 0;         // render() entry, on this object's clock
+        qint64 cpuNs = 0;           // whole render()
+        qint64 texturesNs = 0;      // atlas page uploads at the start of render()
+        // Sim-thread work behind the drawn snapshot, summed over units.
+        qint64 animateNs = 0;
+        qint64 worldNs = 0;
+        qint64 clipNs = 0;          // part of buildNs
+        qint64 buildNs = 0;
+        qint64 uploadNs = 0;        // stream buffer writes
+        qint64 submitNs = 0;        // state changes + draw calls
+        qint64 gpuNs = -1;          // -1 until the timer query resolves, or without one
+        int drawCalls = 0;
+        int vertices = 0;
+        int indices = 0;
+        int textureBinds = 0;
+        int blendSwitches = 0;
+        int clippedSlots = 0;
+        int lodSkippedSlots = 0;    // slots dropped by level of detail
+        int uploadBytes = 0;
+        qint64 bakedBytes = 0;      // baked animation caches of the drawn units
+    };
+
+    SpinePerfCounters();
+
+    bool enabled() const { return m_enabled; }
+    void setEnabled(bool on);
+    // Frames kept for the aggregates and the trace.
+    int window() const { return m_window; }
+    void setWindow(int frames);
+
+    qint64 now() const { return m_clock.nsecsElapsed(); }
+    void record(const Frame& frame);
+    // Frames recorded since the last aggregate().
+    int freshFrames() const { return m_fresh; }
+
+    // Needs a current context. Brackets the frame's GL work; results arrive a few
+    // frames later and are matched to their record by index.
+    void beginGpu(QOpenGLExtraFunctions* gl, quint64 frame);
+    void endGpu(QOpenGLExtraFunctions* gl);
+    void releaseGl(QOpenGLExtraFunctions* gl);
+
+    // {frames, window, gpuFrames, <phase>Ms: {mean, p95, max}, <counter>: {mean, max}}.
+    QVariantMap aggregate();
+    // Chrome trace event JSON (chrome://tracing, Perfetto) of the window. Sim phases are
+    // sums, drawn back to back before the frame that picked them up.
+    bool writeChromeTrace(const QString& path) const;
+
+private:
+    struct Query {
+        GLuint id = 0;
+        quint64 frame = 0;
+        bool pending = false;
+    };
+    static constexpr int kQueries = 4;
+
+    void collectGpu(QOpenGLExtraFunctions* gl);
+    std::vector<const Frame*> ordered() const;
+
+    QElapsedTimer m_clock;
+    bool m_enabled = false;
+    int m_window = 120;
+    std::vector<Frame> m_frames;    // ring of m_window records
+    size_t m_next = 0;
+    size_t m_count = 0;
+    int m_fresh = 0;
+
+    bool m_gpuChecked = false;
+    bool m_gpuSupported = false;
+    Query m_queries[kQueries];
+    int m_nextQuery = 0;
+    int m_activeQuery = -1;
+};
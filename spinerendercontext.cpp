@@ -0,0 +1,403 @@
+#include "spinerendercontext.h"
+#include "spinetexturepool.h"
+
+#include <QDebug>
+#include <QHash>
+#include <QMatrix4x4>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QOpenGLContext>
+#include <cstddef>
+
+namespace {
+// Every unit shader goes through here. Texture pool mode samples a 2D array at the
+// layer the vertex shader passes on as vLayer.
+QByteArray unitShader(const char* body, const char* defines = "") {
+    QByteArray src("#version 330 core\n");
+    if (SpineTexturePool::enabled()) src += "#define TEXTURE_ARRAY\n";
+    return src + defines + body;
+}
+
+const char* kSampleAtlas = R"(
+#ifdef TEXTURE_ARRAY
+    flat in float vLayer;
+    uniform sampler2DArray uTex;
+    vec4 sampleAtlas(vec2 uv) { return texture(uTex, vec3(uv, vLayer)); }
+#else
+    uniform sampler2D uTex;
+    vec4 sampleAtlas(vec2 uv) { return texture(uTex, uv); }
+#endif
+)";
+
+// Shared by the compact layouts and the skin program. Two-color tint for straight-alpha
+// textures: light where the texel is bright, dark where it is dark. A black dark color
+// gives the plain tex * color of the float layout.
+const char* kTintFragmentShader = R"(
+    in vec2 vUV;
+    in vec4 vColor;
+    in vec3 vDark;
+    uniform float uOpacity;
+    out vec4 FragColor;
+    void main(){
+        vec4 tex = sampleAtlas(vUV);
+        vec4 c = vec4(tex.rgb * vColor.rgb + (1.0 - tex.rgb) * vDark, tex.a * vColor.a);
+        c.rgb *= c.a;
+        FragColor = c * uOpacity;
+    }
+)";
+
+// PackedVertex reads colors from normalized RGBA8 attributes, BatchColorVertex from
+// uniforms set per batch. UVs arrive as normalized 16-bit either way. PackedVertex
+// carries the texture pool layer in the otherwise unused dark alpha byte.
+const char* kCompactVertexShader = R"(
+    layout(location=0) in vec2 aPos;
+    layout(location=1) in vec2 aUV;
+#ifdef BATCH_COLOR
+    uniform vec4 uColor;
+    uniform vec4 uDark;
+#else
+    layout(location=2) in vec4 aColor;
+    layout(location=3) in vec4 aDark;
+#endif
+    uniform mat4 uMvp;
+#if defined(TEXTURE_ARRAY) && defined(BATCH_COLOR)
+    uniform float uLayer;
+#endif
+#ifdef TEXTURE_ARRAY
+    flat out float vLayer;
+#endif
+    out vec2 vUV;
+    out vec4 vColor;
+    out vec3 vDark;
+    void main(){
+        gl_Position = uMvp * vec4(aPos, 0.0, 1.0);
+        vUV = aUV;
+#ifdef BATCH_COLOR
+        vColor = uColor;
+        vDark = uDark.rgb;
+#else
+        vColor = aColor;
+        vDark = aDark.rgb;
+#endif
+#if defined(TEXTURE_ARRAY) && defined(BATCH_COLOR)
+        vLayer = uLayer;
+#elif defined(TEXTURE_ARRAY)
+        vLayer = floor(aDark.a * 255.0 + 0.5);
+#endif
+    }
+)";
+
+// One triangle covering the viewport; layer FBOs are already premultiplied.
+const char* kCompositeVertexShader = R"(
+    #version 330 core
+    out vec2 vUV;
+    void main(){
+        vUV = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        gl_Position = vec4(vUV * 2.0 - 1.0, 0.0, 1.0);
+    }
+)";
+
+const char* kCompositeFragmentShader = R"(
+    #version 330 core
+    in vec2 vUV;
+    uniform sampler2D uTex;
+    out vec4 FragColor;
+    void main(){
+        FragColor = texture(uTex, vUV);
+    }
+)";
+
+// Render threads each have their own context, so lookups are locked; the weak entries
+// let the last renderer on a context take the GL objects down with it.
+QMutex g_contextsMutex;
+QHash<QOpenGLContext*, std::weak_ptr<SpineRenderContext>> g_contexts;
+}
+
+std::shared_ptr<SpineRenderContext> SpineRenderContext::acquire() {
+    QOpenGLContext* gl = QOpenGLContext::currentContext();
+    QMutexLocker lock(&g_contextsMutex);
+    std::shared_ptr<SpineRenderContext> ctx = g_contexts.value(gl).lock();
+    if (!ctx) {
+        ctx.reset(new SpineRenderContext);
+        g_contexts.insert(gl, ctx);
+    }
+    return ctx;
+}
+
+SpineRenderContext::~SpineRenderContext() {
+    QMutexLocker lock(&g_contextsMutex);
+    for (auto it = g_contexts.begin(); it != g_contexts.end();) {
+        if (it.value().expired()) it = g_contexts.erase(it);
+        else ++it;
+    }
+}
+
+SpineRenderContext::SpineRenderContext() {
+    initializeOpenGLFunctions();
+
+    m_uploadPbo.create();
+    m_uploadPbo.setUsagePattern(QOpenGLBuffer::StreamDraw);
+
+    const char* vs = R"(
+        layout(location=0) in vec2 aPos;
+        layout(location=1) in vec2 aUV;
+        layout(location=2) in vec4 aColor;
+        uniform mat4 uMvp;
+#ifdef TEXTURE_ARRAY
+        uniform float uLayer;
+        flat out float vLayer;
+#endif
+        out vec2 vUV;
+        out vec4 vColor;
+        void main(){
+            gl_Position = uMvp * vec4(aPos, 0.0, 1.0);
+            vUV = aUV;
+            vColor = aColor;
+#ifdef TEXTURE_ARRAY
+            vLayer = uLayer;
+#endif
+        }
+    )";
+
+    const char* fs = R"(
+        in vec2 vUV;
+        in vec4 vColor;
+        uniform float uOpacity;
+        out vec4 FragColor;
+        void main(){
+            vec4 tex = sampleAtlas(vUV);
+            vec4 c = tex * vColor;
+            c.rgb *= c.a; // premultiply for Qt Quick composition
+            FragColor = c * uOpacity; // premultiplied, so opacity scales all four
+        }
+    )";
+
+    m_program.addShaderFromSourceCode(QOpenGLShader::Vertex, unitShader(vs));
+    m_program.addShaderFromSourceCode(QOpenGLShader::Fragment, unitShader(fs, kSampleAtlas));
+    if (!m_program.link()) qWarning() << "Shader link failed:" << m_program.log();
+
+    const QByteArray tintFs = unitShader(kTintFragmentShader, kSampleAtlas);
+    m_packedProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, unitShader(kCompactVertexShader));
+    m_packedProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, tintFs);
+    if (!m_packedProgram.link()) qWarning() << "[SpineRenderer] packed shader link failed:" << m_packedProgram.log();
+
+    m_batchProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, unitShader(kCompactVertexShader, "#define BATCH_COLOR\n"));
+    m_batchProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, tintFs);
+    if (!m_batchProgram.link()) qWarning() << "[SpineRenderer] batch-color shader link failed:" << m_batchProgram.log();
+    m_batchColorLoc = m_batchProgram.uniformLocation("uColor");
+    m_batchDarkLoc = m_batchProgram.uniformLocation("uDark");
+    // -1 outside texture pool mode, which makes setting them a no-op.
+    m_layerLoc[SpineDrawList::FloatVertex] = m_program.uniformLocation("uLayer");
+    m_layerLoc[SpineDrawList::BatchColorVertex] = m_batchProgram.uniformLocation("uLayer");
+
+    m_vao.create();
+    m_vao.bind();
+
+    m_vbo.create();
+    m_ibo.create();
+
+    m_vbo.bind();
+    m_ibo.bind();
+
+    m_program.bind();
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    setVertexLayout(SpineDrawList::FloatVertex, 0);
+    m_program.release();
+
+    m_vao.release();
+    m_ibo.release();
+    m_vbo.release();
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    initSkinning();
+}
+
+int SpineRenderContext::skinTier(int bones) {
+    int tier = 0;
+    while (tier < kSkinTiers - 1 && bones > kSkinTierBones[tier]) ++tier;
+    return tier;
+}
+
+// Weighted mesh vertices carry up to four (bone, weight, local x/y) influences; the
+// shader blends the bone transforms exactly like spVertexAttachment_computeWorldVertices.
+// GLSL 330 core + std140 uniform blocks, so it runs wherever the main program does
+// (Mesa llvmpipe included). uBones is sized per tier, so a 20-bone unit streams and
+// binds 1 KB instead of the 8 KB a 256-bone block would take.
+void SpineRenderContext::initSkinning() {
+    static_assert(kSkinTierBones[kSkinTiers - 1] == SpineSkinning::kMaxBones, "largest tier holds every skeleton");
+    const char* vs = R"(
+        layout(location=0) in vec2 aUV;
+        layout(location=1) in vec4 aBones;
+        layout(location=2) in vec4 aWeights;
+        layout(location=3) in vec4 aLocalX;
+        layout(location=4) in vec4 aLocalY;
+        layout(std140) uniform Bones { vec4 uBones[MAX_BONES * 2]; };
+        uniform mat4 uMvp;
+        uniform vec4 uColor;
+        uniform vec4 uDark;
+#ifdef TEXTURE_ARRAY
+        uniform float uLayer;
+        flat out float vLayer;
+#endif
+        out vec2 vUV;
+        out vec4 vColor;
+        out vec3 vDark;
+        void main(){
+#ifdef TEXTURE_ARRAY
+            vLayer = uLayer;
+#endif
+            vec2 pos = vec2(0.0);
+            for (int i = 0; i < 4; ++i) {
+                int b = int(aBones[i]) * 2;
+                vec2 local = vec2(aLocalX[i], aLocalY[i]);
+                vec4 r0 = uBones[b];
+                vec4 r1 = uBones[b + 1];
+                pos += aWeights[i] * vec2(dot(r0.xy, local) + r0.z, dot(r1.xy, local) + r1.z);
+            }
+            gl_Position = uMvp * vec4(pos, 0.0, 1.0);
+            vUV = aUV;
+            vColor = uColor;
+            vDark = uDark.rgb;
+        }
+    )";
+
+    m_extra = QOpenGLContext::currentContext()->extraFunctions();
+    const QByteArray fs = unitShader(kTintFragmentShader, kSampleAtlas);
+    for (int tier = 0; tier < kSkinTiers; ++tier) {
+        SkinProgram& skin = m_skin[tier];
+        const QByteArray defines = "#define MAX_BONES " + QByteArray::number(kSkinTierBones[tier]) + "\n";
+        skin.program.addShaderFromSourceCode(QOpenGLShader::Vertex, unitShader(vs, defines.constData()));
+        skin.program.addShaderFromSourceCode(QOpenGLShader::Fragment, fs);
+        if (!skin.program.link()) {
+            qWarning() << "[SpineRenderer] skin shader link failed, GPU skinning disabled:" << skin.program.log();
+            return;
+        }
+        const GLuint block = m_extra->glGetUniformBlockIndex(skin.program.programId(), "Bones");
+        if (block == GL_INVALID_INDEX) {
+            qWarning() << "[SpineRenderer] skin shader has no Bones block, GPU skinning disabled";
+            return;
+        }
+        m_extra->glUniformBlockBinding(skin.program.programId(), block, 0);
+        skin.colorLoc = skin.program.uniformLocation("uColor");
+        skin.darkLoc = skin.program.uniformLocation("uDark");
+        skin.layerLoc = skin.program.uniformLocation("uLayer");
+    }
+
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_uboAlign);
+    m_uboAlign = qMax<GLint>(m_uboAlign, 16);
+    m_boneStream.create();
+    m_boneScratch.assign(size_t(boneBlockBytes(kSkinTiers - 1)) / sizeof(float), 0.f);
+    m_skinReady = true;
+}
+
+// Static buffers for one mesh; the VAO keeps the attribute layout and the index buffer.
+SpineRenderContext::SkinMeshGpu* SpineRenderContext::retainSkinMesh(const SpineSkinnedMesh* mesh) {
+    auto& gpu = m_skinMeshes[mesh];
+    if (gpu) {
+        ++gpu->users;
+        return gpu.get();
+    }
+
+    using V = SpineSkinnedMesh::Vtx;
+    gpu.reset(new SkinMeshGpu);
+    gpu->vao.create();
+    gpu->vao.bind();
+    gpu->vbo.create();
+    gpu->vbo.bind();
+    gpu->vbo.allocate(mesh->verts.data(), int(mesh->verts.size() * sizeof(V)));
+    gpu->ibo.create();
+    gpu->ibo.bind();
+    gpu->ibo.allocate(mesh->indices.data(), int(mesh->indices.size() * sizeof(unsigned short)));
+
+    for (GLuint i = 0; i < 5; ++i) glEnableVertexAttribArray(i);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(V), reinterpret_cast<const void*>(offsetof(V, u)));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(V), reinterpret_cast<const void*>(offsetof(V, bone)));
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(V), reinterpret_cast<const void*>(offsetof(V, weight)));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(V), reinterpret_cast<const void*>(offsetof(V, localX)));
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(V), reinterpret_cast<const void*>(offsetof(V, localY)));
+    gpu->vao.release();
+    gpu->users = 1;
+    return gpu.get();
+}
+
+void SpineRenderContext::releaseSkinMesh(const SpineSkinnedMesh* mesh) {
+    const auto it = m_skinMeshes.find(mesh);
+    if (it != m_skinMeshes.end() && --it->second->users == 0) m_skinMeshes.erase(it);
+}
+
+QOpenGLShaderProgram& SpineRenderContext::program(SpineDrawList::VertexFormat format) {
+    switch (format) {
+    case SpineDrawList::PackedVertex:     return m_packedProgram;
+    case SpineDrawList::BatchColorVertex: return m_batchProgram;
+    default:                              return m_program;
+    }
+}
+
+// Points the attributes at a list that starts byteOffset into the vertex ring, in the
+// list's vertex format. Needs the VAO and vertex ring bound.
+void SpineRenderContext::setVertexLayout(SpineDrawList::VertexFormat format, int byteOffset) {
+    const char* base = reinterpret_cast<const char*>(quintptr(byteOffset));
+    switch (format) {
+    case SpineDrawList::PackedVertex: {
+        using V = SpineDrawList::PackedVtx;
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(V), base + offsetof(V, x));
+        glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(V), base + offsetof(V, u));
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(V), base + offsetof(V, color));
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(V), base + offsetof(V, dark));
+        glEnableVertexAttribArray(2);
+        glEnableVertexAttribArray(3);
+        break;
+    }
+    case SpineDrawList::BatchColorVertex: {
+        using V = SpineDrawList::CompactVtx;
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(V), base + offsetof(V, x));
+        glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(V), base + offsetof(V, u));
+        glDisableVertexAttribArray(2);
+        glDisableVertexAttribArray(3);
+        break;
+    }
+    default: {
+        using V = SpineDrawList::Vtx;
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(V), base + offsetof(V, x));
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(V), base + offsetof(V, u));
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(V), base + offsetof(V, r));
+        glEnableVertexAttribArray(2);
+        glDisableVertexAttribArray(3);
+        break;
+    }
+    }
+}
+
+void SpineRenderContext::setProjection(const QMatrix4x4& mvp, float opacity) {
+    if (m_skinReady) {
+        for (SkinProgram& skin : m_skin) {
+            skin.program.bind();
+            skin.program.setUniformValue("uMvp", mvp);
+            skin.program.setUniformValue("uTex", 0);
+            skin.program.setUniformValue("uOpacity", opacity);
+        }
+    }
+    for (QOpenGLShaderProgram* program : {&m_batchProgram, &m_packedProgram, &m_program}) {
+        program->bind();
+        program->setUniformValue("uMvp", mvp);
+        program->setUniformValue("uTex", 0);
+        program->setUniformValue("uOpacity", opacity);
+    }
+}
+
+bool SpineRenderContext::initComposite() {
+    if (m_compositeProgram.isLinked()) return true;
+    if (m_compositeFailed) return false;
+    m_compositeProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, kCompositeVertexShader);
+    m_compositeProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, kCompositeFragmentShader);
+    if (!m_compositeProgram.link()) {
+        qWarning() << "[SpineRenderContext] composite shader link failed, layers disabled:" << m_compositeProgram.log();
+        m_compositeFailed = true;
+        return false;
+    }
+    m_compositeVao.create();
+    return true;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "spinedrawlist.h"
+#include "spineskinning.h"
+#include "streambuffer.h"
+
+class QMatrix4x4;
+class QOpenGLExtraFunctions;
+
+// GL objects every SpineRenderer on one context shares: the unit, skin and layer
+// composite programs, the vertex / index / bone stream rings and their VAO, the atlas
+// upload PBO and the static buffers of GPU-skinned meshes. Atlas textures and skeleton
+// data are shared one level up, per share group, by SpineAssetCache.
+//
+// One instance per QOpenGLContext (so per render thread), made by the first renderer
+// that draws on it and destroyed with the last one. Renderers take turns within a
+// frame, so nothing here is locked; each still fences its own ring writes with endFrame().
+class SpineRenderContext : protected QOpenGLFunctions {
+public:
+    struct SkinMeshGpu {
+        QOpenGLVertexArrayObject vao;
+        QOpenGLBuffer vbo{QOpenGLBuffer::VertexBuffer};
+        QOpenGLBuffer ibo{QOpenGLBuffer::IndexBuffer};
+        int users = 0;
+    };
+    // The skin program comes in one variant per bone-count tier; a unit binds the smallest
+    // one that holds its skeleton and streams only that many bones.
+    static constexpr int kSkinTiers = 4;
+    static constexpr int kSkinTierBones[kSkinTiers] = {32, 64, 128, SpineSkinning::kMaxBones};
+    static int skinTier(int bones);
+    static constexpr int boneBlockBytes(int tier) {
+        return kSkinTierBones[tier] * SpineSkinning::kFloatsPerBone * int(sizeof(float));
+    }
+
+    // Needs a current context; compiles the programs on first use per context.
+    static std::shared_ptr<SpineRenderContext> acquire();
+    ~SpineRenderContext();
+
+    QOpenGLBuffer& uploadPbo() { return m_uploadPbo; }
+
+    QOpenGLShaderProgram& program(SpineDrawList::VertexFormat format);
+    int batchColorLoc() const { return m_batchColorLoc; }
+    int batchDarkLoc() const { return m_batchDarkLoc; }
+    // Texture pool mode: uLayer of the formats that take the layer per batch; -1 when the
+    // vertices carry it (PackedVertex) or the pool is off.
+    int layerLoc(SpineDrawList::VertexFormat format) const { return m_layerLoc[format]; }
+    // Sets uMvp / uTex / uOpacity on every unit program (the skin program included).
+    // Viewports share the programs, so every frame sets all three.
+    void setProjection(const QMatrix4x4& mvp, float opacity = 1.f);
+
+    // Preallocated rings; batches are written at increasing offsets each frame.
+    StreamBuffer& vertexStream() { return m_vbo; }
+    StreamBuffer& indexStream() { return m_ibo; }
+    QOpenGLVertexArrayObject& vao() { return m_vao; }
+    // Points the attributes at a list that starts byteOffset into the vertex ring, in the
+    // list's vertex format. Needs the VAO and vertex ring bound.
+    void setVertexLayout(SpineDrawList::VertexFormat format, int byteOffset);
+
+    // GPU skinning: static per-mesh buffers made on first use, bone matrices streamed
+    // through a uniform buffer ring, one std140 block of the unit's tier per unit.
+    bool skinReady() const { return m_skinReady; }
+    QOpenGLShaderProgram& skinProgram(int tier) { return m_skin[tier].program; }
+    int skinColorLoc(int tier) const { return m_skin[tier].colorLoc; }
+    int skinDarkLoc(int tier) const { return m_skin[tier].darkLoc; }
+    int skinLayerLoc(int tier) const { return m_skin[tier].layerLoc; }
+    GLint uboAlign() const { return m_uboAlign; }
+    StreamBuffer& boneStream() { return m_boneStream; }
+    std::vector<float>& boneScratch() { return m_boneScratch; }   // one block of the largest tier
+    // Buffers for mesh, made on first use. Each renderer retains a mesh once and releases
+    // it when it goes away: the buffers must not outlive the asset, whose address keys them.
+    SkinMeshGpu* retainSkinMesh(const SpineSkinnedMesh* mesh);
+    void releaseSkinMesh(const SpineSkinnedMesh* mesh);
+
+    // Full-screen triangle that draws one layer texture; linked on first use.
+    bool initComposite();
+    QOpenGLShaderProgram& compositeProgram() { return m_compositeProgram; }
+    QOpenGLVertexArrayObject& compositeVao() { return m_compositeVao; }
+
+private:
+    SpineRenderContext();
+    void initSkinning();
+
+    // Atlas pages stream in through this PBO under a per-frame budget.
+    QOpenGLBuffer m_uploadPbo{QOpenGLBuffer::PixelUnpackBuffer};
+
+    QOpenGLShaderProgram m_program;         // FloatVertex
+    QOpenGLShaderProgram m_packedProgram;   // PackedVertex
+    QOpenGLShaderProgram m_batchProgram;    // BatchColorVertex
+    int m_batchColorLoc = -1;
+    int m_batchDarkLoc = -1;
+    int m_layerLoc[SpineDrawList::VertexFormatCount] = {-1, -1, -1};
+    StreamBuffer m_vbo{QOpenGLBuffer::VertexBuffer, 4 * 1024 * 1024};
+    StreamBuffer m_ibo{QOpenGLBuffer::IndexBuffer, 1024 * 1024};
+    QOpenGLVertexArrayObject m_vao;
+
+    QOpenGLExtraFunctions* m_extra = nullptr;
+    struct SkinProgram {
+        QOpenGLShaderProgram program;
+        int colorLoc = -1;
+        int darkLoc = -1;
+        int layerLoc = -1;
+    };
+    SkinProgram m_skin[kSkinTiers];
+    bool m_skinReady = false;   // every tier linked and uniform buffers usable
+    GLint m_uboAlign = 256;
+    StreamBuffer m_boneStream{QOpenGLBuffer::Type(GL_UNIFORM_BUFFER), 1024 * 1024};
+    std::vector<float> m_boneScratch;   // the bound range must cover the tier's whole block
+    std::unordered_map<const SpineSkinnedMesh*, std::unique_ptr<SkinMeshGpu>> m_skinMeshes;
+
+    QOpenGLShaderProgram m_compositeProgram;
+    QOpenGLVertexArrayObject m_compositeVao;
+    bool m_compositeFailed = false;
+};
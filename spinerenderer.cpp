@@ -1,180 +1,152 @@
 #include "spinerenderer.h"
-#include "spineviewport.h"
+#include "spineviewportbase.h"
+#include "spineassetcache.h"
+#include "spinetexturepool.h"
 
+#include <QCoreApplication>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLFramebufferObject>
 #include <QOpenGLTexture>
-#include <QFile>
-#include <QFileInfo>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QMatrix4x4>
+#include <QPointer>
+#include <QVector3D>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+SpineRenderer::SpineRenderer(const QVariantList& configs, SpineViewportBase* item)
+    : m_sim(configs, item->spawnPools())
+{
+    // Runs on the sim thread and the item may already be gone by then, so hop through
+    // the application object and check a QPointer on the GUI thread.
+    m_sim.setCommandQueue(item->commandQueue());
+
+    QPointer<SpineViewportBase> target(item);
+    m_sim.setWakeCallback([target] {
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [target] {
+            if (target) target->requestFrame();
+        }, Qt::QueuedConnection);
+    });
+    m_sim.start();
+}
 
-SpineRenderer::SpineRenderer(const QVariantList& configs) {
-    for (auto c : configs) {
-        QVariantMap m = c.toMap();
-
-        Unit u;
-        u.name = m.value("name").toString();
-        const QString atlasPath = m.value("atlas").toString();
-        const QString skelPath  = m.value("skel").toString();
-
-        if (u.name.isEmpty() || atlasPath.isEmpty() || skelPath.isEmpty()) {
-            qWarning() << "[SpineRenderer] invalid unit config:" << m;
-            continue;
-        }
-
-        u.atlas = spAtlas_createFromFile(atlasPath.toUtf8().constData(), nullptr);
-        if (!u.atlas) {
-            qWarning() << "[SpineRenderer] failed to load atlas:" << atlasPath;
-            continue;
-        }
-
-        u.binary = spSkeletonBinary_create(u.atlas);
-        u.binary->scale = m.value("scale", 1.0).toFloat();
-
-        QFileInfo fi(skelPath);
-        if (!fi.exists() || fi.size() <= 0) {
-            qWarning() << "[SpineRenderer] missing/empty skel:" << skelPath;
-            continue;
-        }
-
-        QFile f(skelPath);
-        if (!f.open(QIODevice::ReadOnly)) {
-            qWarning() << "[SpineRenderer] cannot open skel:" << skelPath;
-            continue;
-        }
-        QByteArray bytes = f.readAll();
-        f.close();
-
-        u.data = spSkeletonBinary_readSkeletonData(
-            u.binary,
-            reinterpret_cast<const unsigned char*>(bytes.constData()),
-            bytes.size()
-        );
-        if (!u.data) {
-            qWarning() << "[SpineRenderer] failed to parse skel:" << skelPath
-                       << "error:" << (u.binary && u.binary->error ? u.binary->error : "unknown");
-            continue;
-        }
-
-        u.skeleton = spSkeleton_create(u.data);
-        spSkeleton_setToSetupPose(u.skeleton);
-        spSkeleton_updateWorldTransform(u.skeleton);
+SpineRenderer::SpineRenderer(const QVariantList& configs)
+    : m_sim(configs)
+{
+}
 
-        u.stateData = spAnimationStateData_create(u.data);
-        u.state = spAnimationState_create(u.stateData);
+SpineRenderer::~SpineRenderer() {
+    m_sim.stop();
+    if (m_glInited && QOpenGLContext::currentContext()) {
+        m_perf.releaseGl(m_extra);
+        for (const auto& mesh : m_skinMeshes) m_context->releaseSkinMesh(mesh.first);
+    }
+}
 
-        u.x = m.value("x", 0.0).toFloat();
-        u.y = m.value("y", 0.0).toFloat();
-        //u.pma = m.value("pma", false).toBool();
-        u.skeleton->x = u.x;
-        u.skeleton->y = u.y;
+void SpineRenderer::synchronize(QQuickFramebufferObject* item) {
+    synchronize(static_cast<SpineViewportBase*>(item->parentItem()));
+}
 
-        const QString defAnim = m.value("defaultAnim").toString();
-        if (!defAnim.isEmpty()) {
-            QByteArray a = defAnim.toUtf8();
-            spAnimation* anim = spSkeletonData_findAnimation(u.data, a.constData());
-            if (anim) spAnimationState_setAnimation(u.state, 0, anim, 1);
-        }
+void SpineRenderer::synchronize(SpineViewportBase* viewport) {
+    viewport->flushCommands();
+    m_sim.setThreadCount(viewport->threads());
+    m_sim.setRate(viewport->simRate());
+    m_uploadBudgetNs = qint64(viewport->uploadBudget() * 1e6);
+    m_adaptive = viewport->updateMode() == SpineViewportBase::Adaptive;
+    m_sim.setOffscreenMode(SpineSimulation::OffscreenMode(viewport->offscreenMode()), viewport->offscreenInterval());
+    // Until GL is up the skin program's fate is unknown; render() skips skinned batches
+    // it cannot draw and the next sync turns the path off.
+    m_sim.setGpuSkinning(viewport->gpuSkinning() && (!m_glInited || m_context->skinReady()));
+    m_sim.setVertexFormat(SpineDrawList::VertexFormat(viewport->vertexFormat()));
+    if (viewport->layers() != m_layerConfig) {
+        m_layerConfig = viewport->layers();
+        m_layersChanged = true;
+    }
 
-        m_units.push_back(u);
-        qWarning() << "[SpineRenderer] loaded unit:" << u.name;
+    m_perf.setEnabled(viewport->perfCounters());
+    m_perf.setWindow(viewport->perfWindow());
+    // Aggregates go out a few times a second; the GUI thread is blocked right now, but
+    // the property change is delivered like the other notifications.
+    if (m_perf.enabled() && m_perf.freshFrames() >= kPerfPublishFrames) {
+        const QVariantMap stats = m_perf.aggregate();
+        QMetaObject::invokeMethod(viewport, [viewport, stats] {
+            viewport->setPerfStats(stats);
+        }, Qt::QueuedConnection);
+    }
+    const QString tracePath = viewport->takeTraceRequest();
+    if (!tracePath.isEmpty()) {
+        const bool ok = m_perf.writeChromeTrace(tracePath);
+        QMetaObject::invokeMethod(viewport, [viewport, tracePath, ok] {
+            emit viewport->traceDumped(tracePath, ok);
+        }, Qt::QueuedConnection);
     }
-}
 
-SpineRenderer::~SpineRenderer() {
-    if (m_clipper) { spSkeletonClipping_dispose(m_clipper); m_clipper = nullptr; }
-    for (auto &u : m_units) {
-        if (u.state) spAnimationState_dispose(u.state);
-        if (u.stateData) spAnimationStateData_dispose(u.stateData);
-        if (u.skeleton) spSkeleton_dispose(u.skeleton);
-        if (u.data) spSkeletonData_dispose(u.data);
-        if (u.binary) spSkeletonBinary_dispose(u.binary);
-        if (u.atlas) spAtlas_dispose(u.atlas);
+    // Lets tick() stop repainting while nothing moves.
+    const bool animating = !m_sim.isIdle();
+    if (animating != m_reportedAnimating) {
+        m_reportedAnimating = animating;
+        QMetaObject::invokeMethod(viewport, [viewport, animating] {
+            viewport->setAnimating(animating);
+        }, Qt::QueuedConnection);
     }
-}
 
-void SpineRenderer::synchronize(QQuickFramebufferObject* item) {
-    auto viewport = static_cast<SpineViewport*>(item);
-    m_pendingCommands = viewport->takeCommands();
+    // Forward load state / progress changes to QML on the GUI thread.
+    const auto info = m_sim.loadInfo();
+    m_reportedLoad.resize(info.size());
+    for (size_t i = 0; i < info.size(); ++i) {
+        auto& last = m_reportedLoad[i];
+        const bool stateChanged = last.name.isEmpty() || last.state != info[i].state;
+        const bool progressed = info[i].progress - last.progress >= 0.01f || (info[i].progress >= 1.f && last.progress < 1.f);
+        if (!stateChanged && !progressed) continue;
+        last = info[i];
+
+        const QString name = info[i].name;
+        const int state = info[i].state;
+        const double progress = info[i].progress;
+        QMetaObject::invokeMethod(viewport, [viewport, name, state, progress] {
+            viewport->reportLoad(name, state, progress);
+        }, Qt::QueuedConnection);
+    }
 }
 
 QOpenGLFramebufferObject* SpineRenderer::createFramebufferObject(const QSize& size) {
-    m_fboSize = size;
+    setViewSize(size);
+    m_fboDirty = true;
+
     QOpenGLFramebufferObjectFormat format;
     format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
     return new QOpenGLFramebufferObject(size, format);
 }
 
+void SpineRenderer::setViewSize(const QSize& size) {
+    if (size == m_fboSize) return;
+    m_fboSize = size;
+    m_fboDirty = true;
+
+    // Same box as the ortho projection in render().
+    const float hw = size.width() * 0.5f;
+    const float hh = size.height() * 0.5f;
+    m_sim.setView(SpineDrawList::Bounds{-hw, -hh, hw, hh});
+}
+
 void SpineRenderer::initGlIfNeeded() {
     if (m_glInited) return;
 
     initializeOpenGLFunctions();
-
-    m_clipper = spSkeletonClipping_create();
-
-    const char* vs = R"(
-        #version 330 core
-        layout(location=0) in vec2 aPos;
-        layout(location=1) in vec2 aUV;
-        layout(location=2) in vec4 aColor;
-        uniform mat4 uMvp;
-        out vec2 vUV;
-        out vec4 vColor;
-        void main(){
-            gl_Position = uMvp * vec4(aPos, 0.0, 1.0);
-            vUV = aUV;
-            vColor = aColor;
-        }
-    )";
-
-    const char* fs = R"(
-        #version 330 core
-        in vec2 vUV;
-        in vec4 vColor;
-        uniform sampler2D uTex;
-        out vec4 FragColor;
-        void main(){
-            vec4 tex = texture(uTex, vUV);
-            vec4 c = tex * vColor;
-            c.rgb *= c.a; // premultiply for Qt Quick composition
-            FragColor = c;
-        }
-    )";
-
-    m_program.addShaderFromSourceCode(QOpenGLShader::Vertex, vs);
-    m_program.addShaderFromSourceCode(QOpenGLShader::Fragment, fs);
-    if (!m_program.link()) qWarning() << "Shader link failed:" << m_program.log();
-
-    m_vao.create();
-    m_vao.bind();
-
-    m_vbo.create();
-    m_vbo.bind();
-    m_vbo.setUsagePattern(QOpenGLBuffer::DynamicDraw);
-
-    m_ibo.create();
-    m_ibo.bind();
-    m_ibo.setUsagePattern(QOpenGLBuffer::DynamicDraw);
-
-    m_program.bind();
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vtx), (void*)offsetof(Vtx, x));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vtx), (void*)offsetof(Vtx, u));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vtx), (void*)offsetof(Vtx, r));
-    m_program.release();
-
-    m_ibo.release();
-    m_vbo.release();
-    m_vao.release();
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-
+    m_context = SpineRenderContext::acquire();
+    m_extra = QOpenGLContext::currentContext()->extraFunctions();
     m_glInited = true;
 }
 
+SpineRenderContext::SkinMeshGpu* SpineRenderer::skinMesh(const SpineSkinnedMesh* mesh) {
+    auto& gpu = m_skinMeshes[mesh];
+    if (!gpu) gpu = m_context->retainSkinMesh(mesh);
+    return gpu;
+}
+
 void SpineRenderer::setBlend(int blendMode, bool premultipliedAlpha) {
     glEnable(GL_BLEND);
     if (premultipliedAlpha) {
@@ -196,236 +168,466 @@ void SpineRenderer::setBlend(int blendMode, bool premultipliedAlpha) {
     }
 }
 
-SpineRenderer::Unit* SpineRenderer::findUnit(const QString& name) {
-    for (auto &u : m_units) if (u.name == name) return &u;
-    return nullptr;
-}
-
-void SpineRenderer::executeTrigger(const QVariantList& commands) {
-    for (auto cmd : commands) {
-        QVariantMap m = cmd.toMap();
-        const QString unitName = m.value("unit").toString();
-        auto* u = findUnit(unitName);
-        if (!u) continue;
-
-        const QStringList queue = m.value("queue").toStringList();
-        const int track = m.value("track", 0).toInt();
-        const bool loopLast = m.value("loopLast", true).toBool();
-
-        for (int i = 0; i < queue.size(); ++i) {
-            const bool isLast = (i == queue.size() - 1);
-            const bool loop = isLast ? loopLast : false;
-
-            QByteArray a = queue[i].toUtf8();
-            spAnimation* anim = spSkeletonData_findAnimation(u->data, a.constData());
-            if (!anim) continue;
-
-            if (i == 0) spAnimationState_setAnimation(u->state, track, anim, loop ? 1 : 0);
-            else spAnimationState_addAnimation(u->state, track, anim, loop ? 1 : 0, 0);
-        }
+void SpineRenderer::submit(const SpineDrawList& list)
+{
+    if (list.batches.empty()) return;
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 uploadNs = 0;
+
+    SpineRenderContext& gl = *m_context;
+    StreamBuffer& vbo = gl.vertexStream();
+    QOpenGLShaderProgram& program = gl.program(list.format);
+    program.bind();
+
+    const int idxCount = list.indexCount();
+    const int vertBytes = list.vertexBytes();
+    const int idxSize = list.wideIndices ? int(sizeof(quint32)) : int(sizeof(unsigned short));
+    const int idxBytes = idxCount * idxSize;
+
+    int idxOffset = 0;
+    if (vertBytes > 0) {
+        const qint64 uploadStart = clock.nsecsElapsed();
+        const int vertOffset = vbo.write(list.vertexData(), vertBytes, int(sizeof(float)));
+        idxOffset = list.wideIndices
+            ? gl.indexStream().write(list.indices32.data(), idxBytes, idxSize)
+            : gl.indexStream().write(list.indices.data(), idxBytes, idxSize);
+        uploadNs += clock.nsecsElapsed() - uploadStart;
+
+        gl.setVertexLayout(list.format, vertOffset);
     }
-}
 
-void SpineRenderer::drawUnit(Unit& u)
-{
-    const bool premultipliedAlpha = false;
-    if (!m_clipper) return;
-
-    // Start with no clipping.
-    // Spine 3.6 recommends calling clipEnd2 at the end of the skeleton render.
-    for (int i = 0; i < u.skeleton->slotsCount; ++i) {
-        spSlot* slot = u.skeleton->drawOrder[i];
-        if (!slot) continue;
-
-        spAttachment* attachment = slot->attachment;
-
-        // Handle clipping start
-        if (attachment && attachment->type == SP_ATTACHMENT_CLIPPING) {
-            spClippingAttachment* clip = (spClippingAttachment*)attachment;
-            spSkeletonClipping_clipStart(m_clipper, slot, clip);
-            // clipStart slot itself does not draw.
-            spSkeletonClipping_clipEnd(m_clipper, slot);
+    glActiveTexture(GL_TEXTURE0);
+    bool skinBound = false;
+    int boneBytes = 0;
+    const int tier = SpineRenderContext::skinTier(int(list.bones.size()) / SpineSkinning::kFloatsPerBone);
+    for (const auto& batch : list.batches) {
+        if (batch.skinned && !gl.skinReady()) continue;
+
+        if (batch.kind != SpineDrawList::Draw) {
+            if (skinBound) {
+                program.bind();
+                gl.vao().bind();
+                vbo.bind();
+                skinBound = false;
+            }
+            // Both steps invert bit 0 under the clip polygon's fan without touching color:
+            // ClipBegin sets it inside the polygon (even-odd), ClipEnd clears it again.
+            glEnable(GL_STENCIL_TEST);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glStencilMask(0x01);
+            glStencilFunc(GL_ALWAYS, 0, 0x01);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_INVERT);
+            glDrawElements(GL_TRIANGLES, batch.indexCount, list.wideIndices ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT,
+                           reinterpret_cast<const void*>(quintptr(idxOffset + batch.firstIndex * idxSize)));
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            if (batch.kind == SpineDrawList::ClipBegin) {
+                glStencilFunc(GL_EQUAL, 0x01, 0x01);
+                glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+            } else {
+                glDisable(GL_STENCIL_TEST);
+            }
+            ++m_stats.drawCalls;
             continue;
         }
 
-        if (!attachment) {
-            spSkeletonClipping_clipEnd(m_clipper, slot);
+        // A page the texture pool could not place has nothing to sample; drawing it would
+        // read whatever array is still bound.
+        if (!batch.array && !batch.tex) {
+            ++m_stats.untexturedBatches;
             continue;
         }
 
-        float r = u.skeleton->color.r * slot->color.r;
-        float g = u.skeleton->color.g * slot->color.g;
-        float b = u.skeleton->color.b * slot->color.b;
-        float a = u.skeleton->color.a * slot->color.a;
-        spAtlasRegion* region = nullptr;
-
-        // Build base (unclipped) geometry buffers in float arrays, then optionally clip.
-        std::vector<float> baseXY;
-        std::vector<float> baseUV;
-        std::vector<unsigned short> baseIdx;
-
-        if (attachment->type == SP_ATTACHMENT_REGION) {
-            spRegionAttachment* att = (spRegionAttachment*)attachment;
-
-            float world[8];
-            spRegionAttachment_computeWorldVertices(att, slot->bone, world, 0, 2);
-            const float* uvs = att->uvs;
-
-            baseXY.assign(world, world + 8);
-            baseUV.assign(uvs, uvs + 8);
-            baseIdx = {0,1,2, 2,3,0};
-
-            region = (spAtlasRegion*)att->rendererObject;
-        } else if (attachment->type == SP_ATTACHMENT_MESH) {
-            spMeshAttachment* att = (spMeshAttachment*)attachment;
+        // Qt Quick composites FBO as premultiplied alpha; shader premultiplies output.
+        if (batch.blendMode != m_boundBlend) {
+            setBlend(batch.blendMode, true);
+            m_boundBlend = batch.blendMode;
+            ++m_stats.blendSwitches;
+        }
+        // Pooled pages of one array share the binding; only their layer changes.
+        const GLuint texId = batch.array ? batch.array->textureId() : batch.tex ? batch.tex->textureId() : 0;
+        if (texId != m_boundTex) {
+            glBindTexture(batch.array ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D, texId);
+            m_boundTex = texId;
+            ++m_stats.textureBinds;
+        }
 
-            int worldLen = att->super.worldVerticesLength; // floats count (x,y, x,y, ...)
-            baseXY.resize((size_t)worldLen);
-            spVertexAttachment_computeWorldVertices(&att->super, slot, 0, worldLen, baseXY.data(), 0, 2);
+        if (batch.skinned) {
+            if (boneBytes == 0) {
+                // One block per unit, shared by all of its skinned meshes; the bound range
+                // covers the tier's whole uBones array, bones past the skeleton are unused.
+                boneBytes = SpineRenderContext::boneBlockBytes(tier);
+                const qint64 uploadStart = clock.nsecsElapsed();
+                std::copy(list.bones.begin(), list.bones.end(), gl.boneScratch().begin());
+                StreamBuffer& bones = gl.boneStream();
+                bones.bind();
+                const int boneOffset = bones.write(gl.boneScratch().data(), boneBytes, gl.uboAlign());
+                uploadNs += clock.nsecsElapsed() - uploadStart;
+                m_extra->glBindBufferRange(GL_UNIFORM_BUFFER, 0, bones.bufferId(), boneOffset, boneBytes);
+            }
+            QOpenGLShaderProgram& skin = gl.skinProgram(tier);
+            if (!skinBound) {
+                skin.bind();
+                skinBound = true;
+            }
+            skin.setUniformValue(gl.skinColorLoc(tier), batch.color[0], batch.color[1], batch.color[2], batch.color[3]);
+            skin.setUniformValue(gl.skinDarkLoc(tier), batch.dark[0], batch.dark[1], batch.dark[2], batch.dark[3]);
+            if (batch.array) skin.setUniformValue(gl.skinLayerLoc(tier), GLfloat(batch.layer));
+            skinMesh(batch.skinned)->vao.bind();
+            glDrawElements(GL_TRIANGLES, batch.indexCount, GL_UNSIGNED_SHORT, nullptr);
+        } else {
+            if (skinBound) {
+                program.bind();
+                gl.vao().bind();
+                vbo.bind();
+                skinBound = false;
+            }
+            if (list.format == SpineDrawList::BatchColorVertex) {
+                program.setUniformValue(gl.batchColorLoc(), batch.color[0], batch.color[1], batch.color[2], batch.color[3]);
+                program.setUniformValue(gl.batchDarkLoc(), batch.dark[0], batch.dark[1], batch.dark[2], batch.dark[3]);
+            }
+            if (batch.array) program.setUniformValue(gl.layerLoc(list.format), GLfloat(batch.layer));
+            glDrawElements(GL_TRIANGLES, batch.indexCount, list.wideIndices ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT,
+                           reinterpret_cast<const void*>(quintptr(idxOffset + batch.firstIndex * idxSize)));
+        }
 
-            int uvLen = worldLen;
-            baseUV.resize((size_t)uvLen);
-            // UVs are stored as floats [u,v,...] same length as world vertices
-            for (int k = 0; k < uvLen; ++k) baseUV[(size_t)k] = att->uvs[k];
+        ++m_stats.drawCalls;
+    }
+    if (skinBound) {
+        program.bind();
+        gl.vao().bind();
+        vbo.bind();
+    }
 
-            baseIdx.resize((size_t)att->trianglesCount);
-            for (int t = 0; t < att->trianglesCount; ++t) baseIdx[(size_t)t] = (unsigned short)att->triangles[t];
+    m_stats.slots += list.slots;
+    m_stats.vertices += list.vertexCount();
+    m_stats.indices += idxCount;
+    m_stats.vertexBytes += vertBytes;
+    m_stats.uploadBytes += vertBytes + idxBytes + boneBytes;
+    m_stats.skinnedSlots += list.skinnedSlots;
+    m_stats.boneBytes += boneBytes;
+    m_stats.stencilClips += list.stencilClips;
+    m_stats.clippedSlots += list.clippedSlots;
+    m_stats.heapAllocs += list.heapAllocs;
+    m_stats.uploadNs += uploadNs;
+    m_stats.submitNs += clock.nsecsElapsed() - uploadNs;
+}
 
-            region = (spAtlasRegion*)att->rendererObject;
-        } else {
-            spSkeletonClipping_clipEnd(m_clipper, slot);
+// Groups the snapshot's units by their config "layer", in SpineViewport.layers order.
+// Units of an unlisted layer (or none) go to the default layer "", which is drawn on
+// top unless the list places it.
+void SpineRenderer::setupLayers() {
+    m_layersChanged = false;
+    m_layers.clear();
+    m_fboDirty = true;
+    if (m_layerConfig.isEmpty()) return;
+
+    if (!m_context->initComposite()) return;
+    if (!m_layerClock.isValid()) m_layerClock.start();
+
+    auto find = [this](const QString& name) {
+        for (size_t i = 0; i < m_layers.size(); ++i)
+            if (m_layers[i].name == name) return int(i);
+        return -1;
+    };
+    for (const QVariant& v : m_layerConfig) {
+        const QVariantMap m = v.toMap();
+        const QString name = m.value("name").toString();
+        if (find(name) >= 0) {
+            qWarning() << "[SpineRenderer] duplicate layer" << name << "ignored";
             continue;
         }
+        Layer layer;
+        layer.name = name;
+        layer.rate = qMax(0.0, m.value("rate", 0.0).toDouble());
+        m_layers.push_back(std::move(layer));
+    }
+    if (find(QString()) < 0) m_layers.emplace_back();
 
-        if (!region || !region->page || !region->page->rendererObject) {
-            spSkeletonClipping_clipEnd(m_clipper, slot);
-            continue;
-        }
-        // Qt Quick composites FBO as premultiplied alpha; shader premultiplies output.
-        setBlend((int)slot->data->blendMode, true);
-
-        // Apply clipping if active
-        const bool clipping = spSkeletonClipping_isClipping(m_clipper) != 0;
-
-        const float* finalXY = nullptr;
-        const float* finalUV = nullptr;
-        const unsigned short* finalIdx = nullptr;
-        int finalVertFloats = 0;
-        int finalIdxCount = 0;
-
-        if (clipping) {
-            // clipTriangles writes to m_clipper->clippedVertices/UVs/Triangles
-            spSkeletonClipping_clipTriangles(
-                m_clipper,
-                baseXY.data(), (int)baseXY.size(),
-                baseIdx.data(), (int)baseIdx.size(),
-                baseUV.data(),
-                2 // stride in vertices array (x,y)
-            );
-
-            finalXY = m_clipper->clippedVertices->items;
-            finalUV = m_clipper->clippedUVs->items;
-            finalIdx = m_clipper->clippedTriangles->items;
-            finalVertFloats = m_clipper->clippedVertices->size; // floats count
-            finalIdxCount = m_clipper->clippedTriangles->size;  // indices count
-        } else {
-            finalXY = baseXY.data();
-            finalUV = baseUV.data();
-            finalIdx = baseIdx.data();
-            finalVertFloats = (int)baseXY.size();
-            finalIdxCount = (int)baseIdx.size();
-        }
+    const int fallback = find(QString());
+    const std::vector<QString>& unitLayers = m_sim.unitLayers();
+    for (size_t i = 0; i < unitLayers.size(); ++i) {
+        const int layer = find(unitLayers[i]);
+        m_layers[size_t(layer >= 0 ? layer : fallback)].units.push_back(int(i));
+    }
+}
 
-        if (!finalXY || !finalUV || !finalIdx || finalVertFloats < 8 || finalIdxCount < 3) {
-            spSkeletonClipping_clipEnd(m_clipper, slot);
-            continue;
+// Marks the layers to redraw this frame. False when every layer can be reused and the
+// composite in the item FBO is still current.
+bool SpineRenderer::layersDue(const SpineSimulation::Snapshot& snapshot) {
+    const qint64 now = m_layerClock.nsecsElapsed();
+    bool any = false;
+    bool pending = false;
+    for (Layer& layer : m_layers) {
+        layer.redraw = false;
+        if (!layer.fbo || layer.fbo->size() != m_fboSize) {
+            QOpenGLFramebufferObjectFormat format;
+            format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+            layer.fbo.reset(new QOpenGLFramebufferObject(m_fboSize, format));
+            layer.valid = false;
         }
 
-        int vertCount = finalVertFloats / 2;
+        quint64 changed = 0;
+        for (int i : layer.units)
+            if (size_t(i) < snapshot.units.size()) changed = qMax(changed, snapshot.units[size_t(i)].changedStep);
+        if (layer.valid && changed <= layer.drawnStep) continue;
 
-        m_verts.resize((size_t)vertCount);
-        for (int v = 0; v < vertCount; ++v) {
-            m_verts[(size_t)v] = Vtx{
-                finalXY[v*2+0], finalXY[v*2+1],
-                finalUV[v*2+0], finalUV[v*2+1],
-                r,g,b,a
-            };
-        }
+        const bool due = !layer.valid || layer.rate <= 0.0 || now - layer.drawnNs >= qint64(1e9 / layer.rate);
+        layer.redraw = due;
+        any = any || due;
+        pending = pending || !due;
+    }
+    // The sim may go idle before a throttled layer catches up; keep frames coming.
+    if (pending) update();
+    return any || m_fboDirty;
+}
 
-        m_indices.resize((size_t)finalIdxCount);
-        for (int ii = 0; ii < finalIdxCount; ++ii) m_indices[(size_t)ii] = finalIdx[ii];
+// Redraws the due layers into their FBOs, then composites all of them into the FBO that
+// was bound on entry. Needs the unit programs, VAO and rings bound.
+void SpineRenderer::drawLayers(const SpineSimulation::Snapshot& snapshot) {
+    GLint target = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target);
 
-        auto* tex = static_cast<QOpenGLTexture*>(region->page->rendererObject);
-        if (!tex) {
-            spSkeletonClipping_clipEnd(m_clipper, slot);
+    const qint64 now = m_layerClock.nsecsElapsed();
+    for (Layer& layer : m_layers) {
+        if (!layer.redraw) {
+            if (layer.valid) ++m_stats.layersCached;
             continue;
         }
+        layer.fbo->bind();
+        glClearColor(0.f, 0.f, 0.f, 0.f);
+        glClearStencil(0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        for (int i : layer.units)
+            if (size_t(i) < snapshot.units.size()) submit(snapshot.units[size_t(i)]);
+        layer.valid = true;
+        layer.drawnStep = snapshot.step;
+        layer.drawnNs = now;
+        ++m_stats.layersDrawn;
+    }
 
-        m_vbo.bind();
-        m_vbo.allocate(m_verts.data(), int(m_verts.size() * sizeof(Vtx)));
-        m_ibo.bind();
-        m_ibo.allocate(m_indices.data(), int(m_indices.size() * sizeof(unsigned short)));
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(target));
+    glClearColor(0.f, 0.f, 0.f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-        glActiveTexture(GL_TEXTURE0);
-        tex->bind();
+    QOpenGLShaderProgram& composite = m_context->compositeProgram();
+    composite.bind();
+    composite.setUniformValue("uTex", 0);
+    m_context->compositeVao().bind();
+    // Set here too: a frame whose redrawn layers issued no draws never reached setBlend(),
+    // and the state may still be whatever Qt Quick left.
+    glEnable(GL_BLEND);
+    glDisable(GL_STENCIL_TEST);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glActiveTexture(GL_TEXTURE0);
+    for (const Layer& layer : m_layers) {
+        if (!layer.valid) continue;
+        glBindTexture(GL_TEXTURE_2D, layer.fbo->texture());
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        ++m_stats.drawCalls;
+    }
+    m_context->compositeVao().release();
+    m_boundTex = 0;
+    m_boundBlend = -1;
+}
 
-        glDrawElements(GL_TRIANGLES, int(m_indices.size()), GL_UNSIGNED_SHORT, nullptr);
+// Start of both render paths: GL setup, atlas uploads and the newest snapshot.
+const SpineSimulation::Snapshot& SpineRenderer::beginFrame(qint64& frameStart, qint64& texturesNs) {
+    initGlIfNeeded();
 
-        tex->release();
-        m_ibo.release();
-        m_vbo.release();
+    const bool perf = m_perf.enabled();
+    frameStart = perf ? m_perf.now() : 0;
 
-        // This ends clipping when the clip's end slot is reached.
-        spSkeletonClipping_clipEnd(m_clipper, slot);
-    }
+    // Finish any atlas pages the loader threads have decoded.
+    SpineAssetCache::instance().processUploads(&m_context->uploadPbo(), m_uploadBudgetNs);
+    texturesNs = perf ? m_perf.now() - frameStart : 0;
 
-    spSkeletonClipping_clipEnd2(m_clipper);
+    // Animation advances on the simulation thread; just take its newest pose.
+    return m_sim.acquire();
 }
 
 void SpineRenderer::render() {
-    initGlIfNeeded();
-
-    if (!m_pendingCommands.isEmpty()) {
-        executeTrigger(m_pendingCommands);
-        m_pendingCommands.clear();
+    qint64 frameStart = 0;
+    qint64 texturesNs = 0;
+    const SpineSimulation::Snapshot& snapshot = beginFrame(frameStart, texturesNs);
+
+    // Adaptive mode: schedule the next frame ourselves only while something moves.
+    if (m_adaptive && !m_sim.isIdle()) update();
+
+    if (m_layersChanged) setupLayers();
+    const bool layered = !m_layers.empty();
+    if (layered ? !layersDue(snapshot) : !m_fboDirty && snapshot.step == m_drawnStep) {
+        ++m_skippedFrames;
+        return;
     }
+    m_fboDirty = false;
+    m_drawnStep = snapshot.step;
+
+    if (m_perf.enabled()) m_perf.beginGpu(m_extra, m_frameIndex);
 
     glViewport(0, 0, m_fboSize.width(), m_fboSize.height());
     glClearColor(0.f, 0.f, 0.f, 1.f);
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    // Compute real delta time (Qt Quick may render at 60/120/144Hz)
-    if (!m_timer.isValid()) {
-        m_timer.start();
-        m_lastNs = m_timer.nsecsElapsed();
-    }
-    const qint64 nowNs = m_timer.nsecsElapsed();
-    float dt = float(nowNs - m_lastNs) / 1e9f;
-    m_lastNs = nowNs;
-    if (dt < 0.f) dt = 0.f;
-    if (dt > 0.05f) dt = 0.05f; // clamp (tab switch / debugging)
-
-    for (auto &u : m_units) {
-        if (!u.state || !u.skeleton) continue;
-        spAnimationState_update(u.state, dt);
-        spAnimationState_apply(u.state, u.skeleton);
-        spSkeleton_updateWorldTransform(u.skeleton);
-    }
+    glClearStencil(0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
     QMatrix4x4 mvp;
     float w = float(m_fboSize.width());
     float h = float(m_fboSize.height());
     mvp.ortho(-w*0.5f, w*0.5f, -h*0.5f, h*0.5f, -1.f, 1.f);
 
-    m_program.bind();
-    m_program.setUniformValue("uMvp", mvp);
-    m_program.setUniformValue("uTex", 0);
-    m_vao.bind();
+    drawFrame(snapshot, mvp, layered, frameStart, texturesNs);
+}
+
+void SpineRenderer::renderDirect(const QMatrix4x4& mvp, float opacity) {
+    qint64 frameStart = 0;
+    qint64 texturesNs = 0;
+    const SpineSimulation::Snapshot& snapshot = beginFrame(frameStart, texturesNs);
+
+    // The scene graph does not keep our pixels, so every frame draws and nothing is
+    // cleared; clip ranges only need bit 0 of the stencil reset under the item.
+    if (m_perf.enabled()) m_perf.beginGpu(m_extra, m_frameIndex);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    for (const auto& list : snapshot.units) {
+        if (list.stencilClips == 0) continue;
+        clearStencilUnder(mvp);
+        break;
+    }
+
+    drawFrame(snapshot, mvp, false, frameStart, texturesNs, opacity);
+}
 
-    for (auto &u : m_units) {
-        if (u.skeleton) drawUnit(u);
+// Clears the stencil inside the window-space box of the view rect, intersected with the
+// scissor already set for the item's clip. Restores the scissor state.
+void SpineRenderer::clearStencilUnder(const QMatrix4x4& mvp) {
+    GLint vp[4] = {0, 0, 0, 0};
+    glGetIntegerv(GL_VIEWPORT, vp);
+    const float hw = m_fboSize.width() * 0.5f;
+    const float hh = m_fboSize.height() * 0.5f;
+    float x0 = 1e30f, y0 = 1e30f, x1 = -1e30f, y1 = -1e30f;
+    for (const QVector3D& corner : {QVector3D(-hw, -hh, 0.f), QVector3D(hw, -hh, 0.f),
+                                    QVector3D(hw, hh, 0.f), QVector3D(-hw, hh, 0.f)}) {
+        const QVector3D ndc = mvp.map(corner);
+        const float x = vp[0] + (ndc.x() * 0.5f + 0.5f) * vp[2];
+        const float y = vp[1] + (ndc.y() * 0.5f + 0.5f) * vp[3];
+        x0 = qMin(x0, x); x1 = qMax(x1, x);
+        y0 = qMin(y0, y); y1 = qMax(y1, y);
     }
+    int box[4] = {int(std::floor(x0)), int(std::floor(y0)), int(std::ceil(x1)), int(std::ceil(y1))};
+
+    const bool scissored = glIsEnabled(GL_SCISSOR_TEST);
+    GLint saved[4] = {0, 0, 0, 0};
+    if (scissored) {
+        glGetIntegerv(GL_SCISSOR_BOX, saved);
+        box[0] = qMax(box[0], saved[0]);
+        box[1] = qMax(box[1], saved[1]);
+        box[2] = qMin(box[2], saved[0] + saved[2]);
+        box[3] = qMin(box[3], saved[1] + saved[3]);
+    }
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(box[0], box[1], qMax(0, box[2] - box[0]), qMax(0, box[3] - box[1]));
+    glStencilMask(0xff);
+    glClearStencil(0);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    if (scissored) glScissor(saved[0], saved[1], saved[2], saved[3]);
+    else glDisable(GL_SCISSOR_TEST);
+}
 
-    m_vao.release();
-    m_program.release();
+// Shared tail: draws snapshot through mvp into the bound target, then books the stats.
+void SpineRenderer::drawFrame(const SpineSimulation::Snapshot& snapshot, const QMatrix4x4& mvp, bool layered,
+                              qint64 frameStart, qint64 texturesNs, float opacity) {
+    const bool perf = m_perf.enabled();
+    SpineRenderContext& gl = *m_context;
+    gl.setProjection(mvp, opacity);
+    gl.vao().bind();
+    gl.vertexStream().bind();
+    gl.indexStream().bind();
+
+    // Qt Quick may have touched both since the last frame.
+    m_boundTex = 0;
+    m_boundBlend = -1;
+
+    m_stats = FrameStats{};
+    m_stats.culledUnits = snapshot.culledUnits;
+    m_stats.bakedUnits = snapshot.bakedUnits;
+    m_stats.bakedBytes = snapshot.bakedBytes;
+    for (const auto& list : snapshot.units) {
+        m_stats.culledSlots += list.culledSlots;
+        m_stats.lodUnits += list.lodLevel > 0 ? 1 : 0;
+        m_stats.lodSkippedSlots += list.lodSkippedSlots;
+        m_stats.lodMeshes += list.lodMeshes;
+        m_stats.animateNs += list.animateNs;
+        m_stats.worldNs += list.worldNs;
+        m_stats.clipNs += list.clipNs;
+        m_stats.buildNs += list.buildNs;
+        if (!layered) submit(list);
+    }
+    if (layered) drawLayers(snapshot);
+
+    gl.vao().release();
+    gl.indexStream().release();
+    gl.vertexStream().release();
+    gl.program(SpineDrawList::FloatVertex).release();
+
+    gl.vertexStream().endFrame();
+    gl.indexStream().endFrame();
+    if (gl.skinReady()) gl.boneStream().endFrame();
+    if (perf) m_perf.endGpu(m_extra);
+
+    m_lastStats = m_stats;
+    if (perf) {
+        SpinePerfCounters::Frame f;
+        f.index = m_frameIndex;
+        f.startNs = frameStart;
+        f.cpuNs = m_perf.now() - frameStart;
+        f.texturesNs = texturesNs;
+        f.animateNs = m_stats.animateNs;
+        f.worldNs = m_stats.worldNs;
+        f.clipNs = m_stats.clipNs;
+        f.buildNs = m_stats.buildNs;
+        f.uploadNs = m_stats.uploadNs;
+        f.submitNs = m_stats.submitNs;
+        f.drawCalls = m_stats.drawCalls;
+        f.vertices = m_stats.vertices;
+        f.indices = m_stats.indices;
+        f.textureBinds = m_stats.textureBinds;
+        f.blendSwitches = m_stats.blendSwitches;
+        f.clippedSlots = m_stats.clippedSlots;
+        f.lodSkippedSlots = m_stats.lodSkippedSlots;
+        f.uploadBytes = m_stats.uploadBytes;
+        f.bakedBytes = m_stats.bakedBytes;
+        m_perf.record(f);
+    }
+    ++m_frameIndex;
+
+    // SGS_SPINE_STATS=1 prints batching results about once a second.
+    static const bool logStats = qEnvironmentVariableIsSet("SGS_SPINE_STATS");
+    if (logStats && m_frameIndex % 60 == 0) {
+        qDebug() << "[SpineRenderer] slots:" << m_lastStats.slots
+                 << "draws:" << m_lastStats.drawCalls
+                 << "saved:" << m_lastStats.drawCallsSaved()
+                 << "verts:" << m_lastStats.vertices
+                 << "vertexBytes:" << m_lastStats.vertexBytes
+                 << "upload:" << m_lastStats.uploadBytes
+                 << "streamed:" << (gl.vertexStream().stats().bytesStreamed + gl.indexStream().stats().bytesStreamed)
+                 << "reallocs:" << (gl.vertexStream().stats().reallocations + gl.indexStream().stats().reallocations)
+                 << "heapAllocs:" << m_lastStats.heapAllocs
+                 << "culledUnits:" << m_lastStats.culledUnits
+                 << "culledSlots:" << m_lastStats.culledSlots
+                 << "skinned:" << m_lastStats.skinnedSlots
+                 << "boneBytes:" << m_lastStats.boneBytes
+                 << "stencilClips:" << m_lastStats.stencilClips
+                 << "texBinds:" << m_lastStats.textureBinds
+                 << "blendSwitches:" << m_lastStats.blendSwitches
+                 << "untextured:" << m_lastStats.untexturedBatches
+                 << "layersDrawn:" << m_lastStats.layersDrawn
+                 << "layersCached:" << m_lastStats.layersCached
+                 << "baked:" << m_lastStats.bakedUnits
+                 << "bakedBytes:" << m_lastStats.bakedBytes
+                 << "lodUnits:" << m_lastStats.lodUnits
+                 << "lodSkipped:" << m_lastStats.lodSkippedSlots
+                 << "lodMeshes:" << m_lastStats.lodMeshes
+                 << "skipped:" << m_skippedFrames;
+    }
 }
@@ -4,11 +4,22 @@
 #include <QOpenGLShaderProgram>
 #include <QOpenGLBuffer>
 #include <QOpenGLVertexArrayObject>
+#include <QOpenGLTexture>
+#include <QOpenGLFramebufferObject>
+#include <QElapsedTimer>
 #include <QVariantList>
 #include <QSize>
-#include <QElapsedTimer>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
+#include "spinedrawlist.h"
+#include "spineperfcounters.h"
+#include "spinerendercontext.h"
+#include "spinesimulation.h"
+#include "spineskinning.h"
+#include "streambuffer.h"
+
 #ifdef slots
 #  undef slots
 #endif
@@ -24,53 +35,140 @@ extern "C" {
 #include <spine/SkeletonClipping.h>
 }
 
+class QMatrix4x4;
+class QOpenGLExtraFunctions;
+class SpineViewportBase;
+
 class SpineRenderer : public QQuickFramebufferObject::Renderer, protected QOpenGLFunctions {
 public:
+    SpineRenderer(const QVariantList& configs, SpineViewportBase* item);
+    // Headless hosts (SgsSpineRenderBench): the simulation is not started and only moves
+    // through simulation().step(); render() draws into the FBO the caller has bound,
+    // sized by createFramebufferObject().
     explicit SpineRenderer(const QVariantList& configs);
     ~SpineRenderer() override;
 
+    SpineSimulation& simulation() { return m_sim; }
+
     void render() override;
+    // item is SpineViewport's FBO child; both viewports sync through the overload below.
     void synchronize(QQuickFramebufferObject* item) override;
+    void synchronize(SpineViewportBase* viewport);
     QOpenGLFramebufferObject* createFramebufferObject(const QSize& size) override;
 
-private:
-    struct Unit {
-        QString name;
-        spAtlas* atlas = nullptr;
-        spSkeletonBinary* binary = nullptr;
-        spSkeletonData* data = nullptr;
-        spSkeleton* skeleton = nullptr;
-        spAnimationStateData* stateData = nullptr;
-        spAnimationState* state = nullptr;
-        float x = 0.f;
-        float y = 0.f;
-};
+    // Direct drawing (SpineDirectViewport): size is the item box the simulation culls
+    // against, mvp maps skeleton space (origin at the box center, y up) to clip space.
+    // renderDirect() draws the newest snapshot into the bound target without clearing it
+    // and without idle skipping or layers, its output scaled by opacity (premultiplied).
+    void setViewSize(const QSize& size);
+    void renderDirect(const QMatrix4x4& mvp, float opacity = 1.f);
 
-    struct Vtx { float x,y,u,v,r,g,b,a; };
+    // Per-frame submission counters. Every visible slot used to be its own draw call,
+    // so slots - drawCalls is the number of draws the batcher merged away.
+    struct FrameStats {
+        int slots = 0;
+        int drawCalls = 0;
+        int vertices = 0;
+        int indices = 0;
+        int vertexBytes = 0;    // vertex stream only; depends on the vertex format
+        int uploadBytes = 0;
+        // Heap allocations made by the draw path (arena blocks + batch vector growth;
+        // spine-c internals are not counted). Zero once warmed up.
+        int heapAllocs = 0;
+        int culledUnits = 0;    // units entirely outside the viewport
+        int culledSlots = 0;    // slots of visible units rejected by their bounds
+        int skinnedSlots = 0;   // meshes skinned in the vertex shader (in slots too)
+        int boneBytes = 0;      // bone matrices streamed for them (part of uploadBytes)
+        int stencilClips = 0;   // clip ranges masked by the stencil (two draws each, in drawCalls)
+        int clippedSlots = 0;   // slots clipped on the CPU or drawn inside a stencil clip
+        int textureBinds = 0;   // atlas page binds actually issued (repeats are skipped)
+        int blendSwitches = 0;  // blend function changes actually issued
+        int untexturedBatches = 0;  // batches of unplaced pool pages, not drawn
+        int bakedUnits = 0;     // units played back from a baked animation cache
+        qint64 bakedBytes = 0;  // memory held by their caches
+        int layersDrawn = 0;    // layer FBOs redrawn (only with SpineViewport.layers)
+        int layersCached = 0;   // layers composited from last frame's FBO contents
+        int lodUnits = 0;       // drawn units below full detail (SpineLod)
+        int lodSkippedSlots = 0;    // visible slots too small for their unit's level
+        int lodMeshes = 0;      // meshes drawn with their reduced triangle set
+        // CPU time, ns. The first four are the sim-thread cost of the drawn snapshot,
+        // summed over units (clipNs is part of buildNs); upload is the stream buffer
+        // writes in submit() and submit the GL state changes and draw calls around them.
+        qint64 animateNs = 0;
+        qint64 worldNs = 0;
+        qint64 clipNs = 0;
+        qint64 buildNs = 0;
+        qint64 uploadNs = 0;
+        qint64 submitNs = 0;
+        int drawCallsSaved() const { return slots - drawCalls; }
+    };
+    const FrameStats& lastFrameStats() const { return m_lastStats; }
+    // render() calls that reused the previous FBO contents because nothing changed.
+    quint64 skippedFrames() const { return m_skippedFrames; }
+    // Rings are shared by every renderer on the context, and so are their counters.
+    StreamBuffer::Stats vertexStreamStats() const { return m_context ? m_context->vertexStream().stats() : StreamBuffer::Stats{}; }
+    StreamBuffer::Stats indexStreamStats() const { return m_context ? m_context->indexStream().stats() : StreamBuffer::Stats{}; }
 
-    std::vector<Unit> m_units;
-    QVariantList m_pendingCommands;
+private:
+    SpineSimulation m_sim;
     QSize m_fboSize;
 
-    // timing for correct animation speed (vsync/variable refresh)
-    QElapsedTimer m_timer;
-    qint64 m_lastNs = 0;
+    qint64 m_uploadBudgetNs = 4000000;
+    std::vector<SpineSimulation::LoadInfo> m_reportedLoad;
 
+    // Programs, stream rings and skin buffers, shared with every renderer on this context.
     bool m_glInited = false;
-    QOpenGLShaderProgram m_program;
-    QOpenGLBuffer m_vbo{QOpenGLBuffer::VertexBuffer};
-    QOpenGLBuffer m_ibo{QOpenGLBuffer::IndexBuffer};
-    QOpenGLVertexArrayObject m_vao;
+    std::shared_ptr<SpineRenderContext> m_context;
+    QOpenGLExtraFunctions* m_extra = nullptr;
+    // Skinned meshes this renderer has retained in m_context.
+    std::unordered_map<const SpineSkinnedMesh*, SpineRenderContext::SkinMeshGpu*> m_skinMeshes;
 
-    std::vector<Vtx> m_verts;
-    std::vector<unsigned short> m_indices;
+    FrameStats m_stats;
+    FrameStats m_lastStats;
+    quint64 m_frameIndex = 0;
+    // GL state already set this frame, so repeats across batches and units are skipped.
+    GLuint m_boundTex = 0;   // atlas texture or pool array
+    int m_boundBlend = -1;
 
-    spSkeletonClipping* m_clipper = nullptr;
+    // Rolling per-frame records for SpineViewport.perfStats; off unless enabled there.
+    SpinePerfCounters m_perf;
+    static constexpr int kPerfPublishFrames = 15;
 
-    Unit* findUnit(const QString& name);
-    void executeTrigger(const QVariantList& commands);
+    // Idle-frame skipping: the FBO keeps its contents, so a frame with the same snapshot
+    // and the same FBO need not be redrawn.
+    quint64 m_drawnStep = 0;
+    bool m_fboDirty = true;
+    quint64 m_skippedFrames = 0;
+    bool m_adaptive = false;
+    bool m_reportedAnimating = true;
+
+    // Layer caching (SpineViewport.layers): each layer keeps its units in an FBO of its
+    // own, redrawn only once one of them changed and its refresh interval has passed.
+    // Frames composite the layer textures back to front. No layers = direct drawing.
+    struct Layer {
+        QString name;
+        double rate = 0.0;              // redraws per second; 0 = on every change
+        std::vector<int> units;         // indices into Snapshot::units
+        std::unique_ptr<QOpenGLFramebufferObject> fbo;
+        quint64 drawnStep = 0;
+        qint64 drawnNs = 0;
+        bool valid = false;             // fbo holds a complete draw at the current size
+        bool redraw = false;            // this frame
+    };
+    std::vector<Layer> m_layers;
+    QVariantList m_layerConfig;
+    bool m_layersChanged = false;
+    QElapsedTimer m_layerClock;
 
     void initGlIfNeeded();
+    const SpineSimulation::Snapshot& beginFrame(qint64& frameStart, qint64& texturesNs);
+    void drawFrame(const SpineSimulation::Snapshot& snapshot, const QMatrix4x4& mvp, bool layered,
+                   qint64 frameStart, qint64 texturesNs, float opacity = 1.f);
+    void clearStencilUnder(const QMatrix4x4& mvp);
+    void setupLayers();
+    bool layersDue(const SpineSimulation::Snapshot& snapshot);
+    void drawLayers(const SpineSimulation::Snapshot& snapshot);
+    SpineRenderContext::SkinMeshGpu* skinMesh(const SpineSkinnedMesh* mesh);
     void setBlend(int blendMode, bool premultipliedAlpha);
-    void drawUnit(Unit& u);
+    void submit(const SpineDrawList& list);
 };
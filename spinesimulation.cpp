@@ -0,0 +1,693 @@
+#include "spinesimulation.h"
+
+#include "spineassetcache.h"
+#include "spinebakedanimation.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QThread>
+#include <cmath>
+#include <limits>
+
+// A cache being built off the sim thread. The task fills result, then sets done.
+struct SpineSimulation::BakeJob {
+    SpineDrawList::VertexFormat format = SpineDrawList::FloatVertex;
+    bool stencilClip = false;
+    std::unique_ptr<SpineBakedAnimation> result;
+    qint64 ms = 0;
+    std::atomic<bool> done{false};
+};
+
+SpineSimulation::SpineSimulation(const QVariantList& configs, const QVariantList& pools) {
+    m_bakers.setMaxThreadCount(1);
+    for (auto c : configs) {
+        QVariantMap m = c.toMap();
+        m_unitOfConfig.push_back(-1);
+
+        Unit u;
+        if (!configure(u, m)) {
+            qWarning() << "[SpineSimulation] invalid unit config:" << m;
+            continue;
+        }
+        u.bake = m.value("bake", false).toBool();
+        u.bakeRate = qBound(1.f, m.value("bakeRate", 30.0).toFloat(), 240.f);
+
+        m_unitOfConfig.back() = int(m_units.size());
+        m_unitLayers.push_back(m.value("layer").toString());
+        m_units.push_back(std::move(u));
+    }
+
+    // Pool instances are plain units that start idle; everything they need is allocated
+    // here and in instantiate(), never on the Spawn path.
+    for (int p = 0; p < pools.size(); ++p) {
+        const QVariantMap m = pools[p].toMap();
+        const int count = poolCapacity(m);
+        const size_t first = m_unitOfConfig.size();
+        m_unitOfConfig.resize(first + size_t(count), -1);
+
+        for (int i = 0; i < count; ++i) {
+            Unit u;
+            if (!configure(u, m)) {
+                qWarning() << "[SpineSimulation] invalid spawn pool config:" << m;
+                break;
+            }
+            u.pool = p;
+            u.active = false;
+            m_unitOfConfig[first + size_t(i)] = int(m_units.size());
+            m_unitLayers.push_back(m.value("layer").toString());
+            m_units.push_back(std::move(u));
+        }
+    }
+
+    for (int i = 0; i < 3; ++i) m_snapshots.slot(i).units.resize(m_units.size());
+}
+
+int SpineSimulation::poolCapacity(const QVariantMap& pool) {
+    return qBound(0, pool.value("count", 1).toInt(), 4096);
+}
+
+// Keys shared by units and spawn pools. Acquires the asset; false if the config is unusable.
+bool SpineSimulation::configure(Unit& u, const QVariantMap& m) {
+    u.name = m.value("name").toString();
+    const QString atlasPath = m.value("atlas").toString();
+    const QString skelPath  = m.value("skel").toString();
+    if (u.name.isEmpty() || atlasPath.isEmpty() || skelPath.isEmpty()) return false;
+
+    // Skeleton data, animation mixes and atlas textures are shared across every
+    // unit and viewport that loads the same files. Loading continues in the
+    // background; the unit is instantiated on the sim thread once it is Ready.
+    u.asset = SpineAssetCache::instance().acquire(atlasPath, skelPath, m.value("scale", 1.0).toFloat());
+
+    u.x = m.value("x", 0.0).toFloat();
+    u.y = m.value("y", 0.0).toFloat();
+    //u.pma = m.value("pma", false).toBool();
+    const QString defaultAnim = m.value("defaultAnim").toString();
+    if (!defaultAnim.isEmpty()) u.defaultAnim = SpineCommand::animationHandle(defaultAnim.toUtf8());
+    const QString clip = m.value("clip", "cpu").toString();
+    if (clip != "cpu" && clip != "stencil")
+        qWarning() << "[SpineSimulation] unknown clip mode" << clip << "for" << u.name << "- using cpu";
+    u.stencilClip = clip == "stencil";
+
+    const QVariantList lod = m.value("lod").toList();
+    const QVariantList lodRates = m.value("lodRates").toList();
+    for (int i = 0; i < SpineLod::kLevels - 1; ++i) {
+        if (i < lod.size()) u.lodSizes[i] = qMax(0.f, lod[i].toFloat());
+        if (i < lodRates.size()) u.lodInterval[i] = 1.f / qBound(1.f, lodRates[i].toFloat(), 240.f);
+    }
+    if (u.lodSizes[0] > 0.f && u.lodSizes[1] > u.lodSizes[0])
+        qWarning() << "[SpineSimulation] lod sizes of" << u.name << "should be descending:" << lod;
+    return true;
+}
+
+SpineSimulation::Unit::Unit() = default;
+SpineSimulation::Unit::Unit(Unit&&) = default;
+SpineSimulation::Unit::~Unit() = default;
+
+SpineSimulation::~SpineSimulation() {
+    stop();
+    // Bake tasks read the skeleton data the assets below own.
+    m_bakers.waitForDone();
+    for (auto &u : m_units) {
+        if (u.clipper) spSkeletonClipping_dispose(u.clipper);
+        if (u.state) spAnimationState_dispose(u.state);
+        if (u.skeleton) spSkeleton_dispose(u.skeleton);
+        SpineAssetCache::instance().release(u.asset);
+    }
+}
+
+void SpineSimulation::instantiate(Unit& u) {
+    u.skeleton = spSkeleton_create(u.asset->data);
+    u.state = spAnimationState_create(u.asset->stateData);
+    u.clipper = spSkeletonClipping_create();
+    resetPose(u);
+
+    if (u.pool < 0) qWarning() << "[SpineSimulation] loaded unit:" << u.name;
+
+    // Commands that arrived while loading, in their original order. They change the
+    // track, so such a unit starts live.
+    std::vector<SpineCommand> deferred;
+    deferred.swap(u.deferred);
+    if (!deferred.empty()) u.bake = false;
+    for (const auto& c : deferred) execute(c);
+    // A bake unit starts its cache on its first update (pollBake).
+}
+
+// Setup pose at the unit's position, playing only its default animation. Recycles pool
+// instances: nothing is parsed or created beyond the track entry spine-c makes for any
+// setAnimation.
+void SpineSimulation::resetPose(Unit& u) {
+    spSkeleton_setToSetupPose(u.skeleton);
+    spAnimationState_clearTracks(u.state);
+    u.skeleton->x = u.x;
+    u.skeleton->y = u.y;
+    spSkeleton_updateWorldTransform(u.skeleton);
+
+    const auto& animations = u.asset->animations;
+    spAnimation* anim = (u.defaultAnim >= 0 && u.defaultAnim < int(animations.size()))
+        ? animations[(size_t)u.defaultAnim] : nullptr;
+    if (anim) spAnimationState_setAnimation(u.state, 0, anim, 1);
+}
+
+void SpineSimulation::spawn(Unit& u, float x, float y) {
+    if (u.active) qWarning() << "[SpineSimulation] spawning" << u.name << "instance that is still in play";
+    u.active = true;
+    u.x = x;
+    u.y = y;
+    u.dirty = true;
+    u.visible = true;
+    u.offscreenTime = 0.f;
+    u.offscreenDt = 0.f;
+    u.lodSize = std::numeric_limits<float>::infinity();
+    // Not loaded yet: instantiate() poses it.
+    if (u.skeleton) resetPose(u);
+}
+
+void SpineSimulation::despawn(Unit& u) {
+    u.active = false;
+    u.dirty = true;
+    u.deferred.clear();
+}
+
+// Builds the cache of the unit's current looping animation on m_bakers, from a
+// skeleton of its own; the unit keeps playing live meanwhile.
+void SpineSimulation::startBake(Unit& u) {
+    spTrackEntry* entry = spAnimationState_getCurrent(u.state, 0);
+    if (!entry || !entry->loop || u.state->tracksCount != 1) {
+        qWarning() << "[SpineSimulation] cannot bake" << u.name << "- needs one looping defaultAnim of at most"
+                   << SpineBakedAnimation::kMaxFrames << "frames; playing live";
+        u.bake = false;
+        return;
+    }
+    auto job = std::make_shared<BakeJob>();
+    job->format = SpineDrawList::VertexFormat(m_vertexFormat.load());
+    job->stencilClip = u.stencilClip;
+    u.bakeJob = job;
+
+    spSkeletonData* data = u.asset->data;
+    spAnimation* animation = entry->animation;
+    const float rate = u.bakeRate;
+    m_bakers.start([job, data, animation, rate] {
+        QElapsedTimer clock;
+        clock.start();
+        spSkeleton* skeleton = spSkeleton_create(data);
+        spSkeletonClipping* clipper = spSkeletonClipping_create();
+        FrameArena arena;
+        job->result = SpineBakedAnimation::bake(skeleton, animation, clipper, arena, rate,
+                                                job->format, job->stencilClip);
+        spSkeletonClipping_dispose(clipper);
+        spSkeleton_dispose(skeleton);
+        job->ms = clock.elapsed();
+        job->done.store(true, std::memory_order_release);
+    });
+}
+
+// Sim thread, bake units only: starts the cache, adopts a finished one, or drops one
+// whose vertex format / clip mode no longer matches and bakes again.
+void SpineSimulation::pollBake(Unit& u) {
+    const auto format = SpineDrawList::VertexFormat(m_vertexFormat.load(std::memory_order_relaxed));
+    if (u.baked && (u.baked->format() != format || u.baked->stencilClipping() != u.stencilClip)) {
+        // Live again from the same point in the loop until the new cache is ready.
+        if (spTrackEntry* entry = spAnimationState_getCurrent(u.state, 0)) entry->trackTime = u.bakedTime;
+        u.baked.reset();
+        u.visible = true;
+    }
+    if (u.baked) return;
+    if (!u.bakeJob) {
+        startBake(u);
+        return;
+    }
+    if (!u.bakeJob->done.load(std::memory_order_acquire)) return;
+
+    const std::shared_ptr<BakeJob> job = std::move(u.bakeJob);
+    if (!job->result) {
+        qWarning() << "[SpineSimulation] cannot bake" << u.name << "- needs one looping defaultAnim of at most"
+                   << SpineBakedAnimation::kMaxFrames << "frames; playing live";
+        u.bake = false;
+        return;
+    }
+    if (job->format != format || job->stencilClip != u.stencilClip) {
+        startBake(u);
+        return;
+    }
+    u.baked = std::move(job->result);
+    spTrackEntry* entry = spAnimationState_getCurrent(u.state, 0);
+    u.bakedTime = entry ? std::fmod(entry->trackTime, u.baked->duration()) : 0.f;
+    u.lod = 0;
+    u.lodPrimed = false;
+    u.dirty = true;
+    qDebug() << "[SpineSimulation] baked" << u.name << u.baked->frameCount() << "frames,"
+             << u.baked->bytes() / 1024 << "KB in" << job->ms << "ms";
+}
+
+// Back to skeletal evaluation, continuing the loop where playback was.
+void SpineSimulation::leaveBaked(Unit& u) {
+    if (u.baked) {
+        if (spTrackEntry* entry = spAnimationState_getCurrent(u.state, 0)) entry->trackTime = u.bakedTime;
+    }
+    u.baked.reset();
+    u.bakeJob.reset();  // a running task finishes into nothing
+    u.bake = false;
+    u.visible = true;
+}
+
+std::vector<SpineSimulation::LoadInfo> SpineSimulation::loadInfo() const {
+    std::vector<LoadInfo> out;
+    out.reserve(m_units.size());
+    for (size_t i = 0; i < m_units.size(); ++i) {
+        // A pool reports once, under its name, through its first instance.
+        const Unit& u = m_units[i];
+        if (u.pool >= 0 && i > 0 && m_units[i - 1].pool == u.pool) continue;
+        LoadInfo info;
+        info.name = u.name;
+        info.state = u.asset->state.load();
+        info.progress = u.asset->progress.load();
+        out.push_back(info);
+    }
+    return out;
+}
+
+void SpineSimulation::start() {
+    if (m_thread) return;
+    if (m_threadCount.load() == 0) setThreadCount(0);
+
+    // Publish the setup pose so the first rendered frame is not empty.
+    advance(0.f, m_snapshots.writeBuffer());
+    m_snapshots.publish();
+    m_idle = !m_animating;
+
+    m_stop = false;
+    if (m_commands) {
+        m_commands->setWaker([this] {
+            QMutexLocker lock(&m_mutex);
+            m_wake.wakeAll();
+        });
+    }
+    m_thread = QThread::create([this] { run(); });
+    m_thread->setObjectName(QStringLiteral("SpineSimulation"));
+    m_thread->start();
+}
+
+void SpineSimulation::step(float dt) {
+    applyPendingView();
+    applyPendingCommands();
+    advance(dt, m_snapshots.writeBuffer());
+    m_snapshots.publish();
+    m_idle = !m_animating;
+}
+
+void SpineSimulation::stop() {
+    if (!m_thread) return;
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stop = true;
+        m_wake.wakeAll();
+    }
+    m_thread->wait();
+    if (m_commands) m_commands->setWaker({});
+    delete m_thread;
+    m_thread = nullptr;
+    m_pool.waitForDone();
+}
+
+void SpineSimulation::setRate(double hz) {
+    if (hz > 0.0) m_rate = hz;
+}
+
+void SpineSimulation::setThreadCount(int threads) {
+    if (threads <= 0) threads = QThread::idealThreadCount();
+    if (threads == m_threadCount.load()) return;
+    m_threadCount = threads;
+    // The sim thread is one of the workers.
+    m_pool.setMaxThreadCount(qMax(1, threads - 1));
+}
+
+void SpineSimulation::setView(const SpineDrawList::Bounds& view) {
+    QMutexLocker lock(&m_mutex);
+    m_pendingView = view;
+    m_viewChanged = true;
+    m_wake.wakeAll();
+}
+
+void SpineSimulation::setOffscreenMode(OffscreenMode mode, double interval) {
+    m_offscreenMode = mode;
+    m_offscreenInterval = qMax(0.0, interval);
+}
+
+void SpineSimulation::setGpuSkinning(bool enabled) {
+    if (m_gpuSkinning.exchange(enabled) != enabled) requestRebuild();
+}
+
+void SpineSimulation::setVertexFormat(SpineDrawList::VertexFormat format) {
+    if (m_vertexFormat.exchange(format) != format) requestRebuild();
+}
+
+void SpineSimulation::setLodOverride(int level) {
+    level = qBound(-1, level, SpineLod::kLevels - 1);
+    if (m_lodOverride.exchange(level) != level) requestRebuild();
+}
+
+// Rebuilds the draw lists even when idle, like a view change.
+void SpineSimulation::requestRebuild() {
+    QMutexLocker lock(&m_mutex);
+    m_viewChanged = true;
+    m_wake.wakeAll();
+}
+
+bool SpineSimulation::applyPendingView() {
+    {
+        QMutexLocker lock(&m_mutex);
+        if (!m_viewChanged) return false;
+        m_view = m_pendingView;
+        m_viewChanged = false;
+    }
+    // Re-test every off-screen unit against the new view on this step.
+    for (auto& u : m_units) {
+        u.offscreenTime = std::numeric_limits<float>::infinity();
+        u.dirty = true;
+    }
+    return true;
+}
+
+const SpineSimulation::Snapshot& SpineSimulation::acquire() {
+    m_snapshots.fetch();
+    return m_snapshots.readBuffer();
+}
+
+bool SpineSimulation::applyPendingCommands() {
+    if (!m_commands) return false;
+    bool any = false;
+    SpineCommand c;
+    while (m_commands->pop(&c)) {
+        execute(c);
+        any = true;
+    }
+    return any;
+}
+
+void SpineSimulation::run() {
+    QElapsedTimer clock;
+    clock.start();
+    qint64 lastNs = clock.nsecsElapsed();
+    double pending = 0.0;   // real time not yet simulated
+
+    while (!m_stop.load()) {
+        const double stepSec = 1.0 / m_rate.load();
+
+        const qint64 nowNs = clock.nsecsElapsed();
+        double elapsed = double(nowNs - lastNs) / 1e9;
+        lastNs = nowNs;
+        if (elapsed < 0.0) elapsed = 0.0;
+        if (elapsed > 0.05) elapsed = 0.05; // clamp (suspend / debugging)
+
+        const bool viewChanged = applyPendingView();
+        const bool commandsApplied = applyPendingCommands() || viewChanged;
+        const bool instantiable = hasInstantiableUnits();
+
+        bool published = false;
+        if (!m_animating && !commandsApplied && !instantiable) {
+            // Nothing can change: skip the update and keep the last snapshot. Time spent
+            // parked is not banked.
+            pending = 0.0;
+        } else {
+            pending += elapsed;
+
+            // Whole steps only; several due steps collapse into one update of their total.
+            const int steps = int(pending / stepSec);
+            if (steps > 0 || commandsApplied || instantiable) {
+                pending -= steps * stepSec;
+                advance(float(steps * stepSec), m_snapshots.writeBuffer());
+                m_snapshots.publish();
+                published = true;
+            }
+        }
+
+        const bool wasIdle = m_idle.load();
+        m_idle = !m_animating;
+        if (published && (wasIdle || !m_animating) && m_onWake) m_onWake();
+
+        const unsigned long waitMs = (unsigned long)qMax(0.0, (stepSec - pending) * 1000.0);
+        QMutexLocker lock(&m_mutex);
+        if (!m_stop.load() && (!m_commands || m_commands->isEmpty()) && !m_viewChanged) {
+            // Idle with nothing loading: sleep until a command, a view change or stop().
+            if (!m_animating && !hasLoadingUnits()) m_wake.wait(&m_mutex);
+            else m_wake.wait(&m_mutex, qMax(1ul, waitMs));
+        }
+    }
+}
+
+bool SpineSimulation::isAnimating(const spAnimationState* state) {
+    if (!state || state->timeScale == 0.f) return false;
+    for (int i = 0; i < state->tracksCount; ++i) {
+        const spTrackEntry* e = state->tracks[i];
+        if (!e) continue;
+        if (e->next || e->mixingFrom) return true;
+        if (e->timeScale == 0.f) continue;  // paused
+        const float duration = e->animationEnd - e->animationStart;
+        if (e->loop ? duration > 0.f : e->trackTime < duration) return true;
+    }
+    return false;
+}
+
+bool SpineSimulation::hasInstantiableUnits() const {
+    for (const auto& u : m_units) {
+        if (!u.skeleton && u.asset->state.load() == SpineSkeletonAsset::Ready) return true;
+    }
+    return false;
+}
+
+bool SpineSimulation::hasLoadingUnits() const {
+    for (const auto& u : m_units) {
+        if (u.skeleton) continue;
+        const int state = u.asset->state.load();
+        if (state == SpineSkeletonAsset::Loading || state == SpineSkeletonAsset::Uploading) return true;
+    }
+    return false;
+}
+
+void SpineSimulation::updateUnit(Unit& u, float dt, SpineDrawList& out) {
+    if (!u.state || !u.skeleton || !u.active) {
+        out.clear();
+        u.animating = false;
+        u.lod = 0;
+        u.lodPrimed = false;
+        return;
+    }
+
+    if (u.bake) pollBake(u);
+    if (u.baked) {
+        spTrackEntry* entry = spAnimationState_getCurrent(u.state, 0);
+        const float scale = u.state->timeScale * (entry ? entry->timeScale : 1.f);
+        u.bakedTime = std::fmod(u.bakedTime + dt * scale, u.baked->duration());
+        u.baked->sample(u.bakedTime, out);
+        u.animating = scale != 0.f;
+        u.visible = out.bounds.intersects(m_view);
+        if (!u.visible) {
+            const qint64 sampleNs = out.buildNs;
+            out.clear();
+            out.buildNs = sampleNs;
+        }
+        out.culled = !u.visible;
+        return;
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+
+    const int mode = m_offscreenMode.load();
+
+    // Level of detail from the size at the last build; off-screen units have their own
+    // schedule. Leaving a level keeps the state time it already ran ahead.
+    const int lod = u.visible ? lodLevel(u) : 0;
+    const float ahead = u.lodPrimed && u.lod > 0 ? qMax(0.f, u.lodInterval[u.lod - 1] - u.lodTime) : 0.f;
+    if (lod != u.lod || u.dirty) u.lodPrimed = false;
+    u.lod = lod;
+
+    qint64 animateNs = 0;
+    qint64 worldNs = 0;
+    if (lod > 0) {
+        poseLod(u, dt, ahead);
+        animateNs = clock.nsecsElapsed();
+    } else {
+        if (!u.visible && mode != OffscreenFull) {
+            // Off-screen: keep time moving, but pose only often enough to notice the unit
+            // coming back into view.
+            u.offscreenTime += dt;
+            if (mode == OffscreenTimeOnly) spAnimationState_update(u.state, dt);
+            else u.offscreenDt += dt;
+
+            if (u.offscreenTime < float(m_offscreenInterval.load())) {
+                u.animating = isAnimating(u.state);   // as of the last refresh for Reduced
+                out.clear();
+                out.culled = true;
+                out.animateNs = clock.nsecsElapsed();
+                return;
+            }
+            u.offscreenTime = 0.f;
+            if (mode == OffscreenReduced) {
+                spAnimationState_update(u.state, u.offscreenDt);
+                u.offscreenDt = 0.f;
+            }
+        } else {
+            spAnimationState_update(u.state, qMax(0.f, dt - ahead));
+        }
+        spAnimationState_apply(u.state, u.skeleton);
+        animateNs = clock.nsecsElapsed();
+        spSkeleton_updateWorldTransform(u.skeleton);
+        worldNs = clock.nsecsElapsed() - animateNs;
+    }
+    // A blended unit still moves until both poses of its pair agree.
+    u.animating = isAnimating(u.state) || (lod > 0 && u.lodPose[0] != u.lodPose[1]);
+
+    u.arena.reset();
+    const int arenaAllocs = u.arena.heapAllocations();
+
+    if (!u.visible) {
+        // Last seen off-screen: measure before paying for tessellation.
+        const qint64 measureStart = clock.nsecsElapsed();
+        if (!SpineDrawList::measure(u.skeleton, u.arena).intersects(m_view)) {
+            out.clear();
+            out.culled = true;
+            out.heapAllocs = u.arena.heapAllocations() - arenaAllocs;
+            out.animateNs = animateNs;
+            out.worldNs = worldNs;
+            out.buildNs = clock.nsecsElapsed() - measureStart;
+            return;
+        }
+        u.arena.reset();
+    }
+
+    out.format = SpineDrawList::VertexFormat(m_vertexFormat.load(std::memory_order_relaxed));
+    out.stencilClipping = u.stencilClip;
+    out.build(u.skeleton, u.clipper, u.arena, m_view,
+              m_gpuSkinning.load(std::memory_order_relaxed) ? &u.asset->skinnedMeshes : nullptr,
+              SpineDrawList::Lod{SpineLod::kMinSlotSize[lod],
+                                 lod >= SpineLod::kMeshLevel ? &u.asset->lodMeshes : nullptr});
+    out.heapAllocs += u.arena.heapAllocations() - arenaAllocs;
+    out.animateNs = animateNs;
+    out.worldNs = worldNs;
+    u.visible = out.bounds.intersects(m_view);
+    out.culled = !u.visible;
+    u.lodSize = out.bounds.isEmpty() ? std::numeric_limits<float>::infinity()
+                                     : qMax(out.bounds.maxX - out.bounds.minX, out.bounds.maxY - out.bounds.minY);
+}
+
+int SpineSimulation::lodLevel(const Unit& u) const {
+    const int forced = m_lodOverride.load(std::memory_order_relaxed);
+    if (forced >= 0) return forced;
+    return SpineLod::level(u.lodSize, u.lodSizes, u.lod);
+}
+
+// Reduced-rate pose: the state is evaluated once per lod interval, one interval ahead
+// of the displayed time, and the bones are blended between the last two results.
+// Steps in between skip apply and the world transform entirely.
+void SpineSimulation::poseLod(Unit& u, float dt, float ahead) {
+    const float interval = u.lodInterval[u.lod - 1];
+    u.lodTime += dt;
+    if (!u.lodPrimed || u.lodTime >= 2.f * interval) {
+        // (Re)start the pair at the current time.
+        spAnimationState_update(u.state, qMax(0.f, dt - ahead));
+        spAnimationState_apply(u.state, u.skeleton);
+        spSkeleton_updateWorldTransform(u.skeleton);
+        SpineLod::capturePose(u.skeleton, u.lodPose[0]);
+        u.lodTime = 0.f;
+        u.lodPrimed = true;
+    } else if (u.lodTime < interval) {
+        SpineLod::blendPose(u.skeleton, u.lodPose[0], u.lodPose[1], u.lodTime / interval);
+        return;
+    } else {
+        u.lodTime -= interval;
+        u.lodPose[0].swap(u.lodPose[1]);
+    }
+    spAnimationState_update(u.state, interval);
+    spAnimationState_apply(u.state, u.skeleton);
+    spSkeleton_updateWorldTransform(u.skeleton);
+    SpineLod::capturePose(u.skeleton, u.lodPose[1]);
+    SpineLod::blendPose(u.skeleton, u.lodPose[0], u.lodPose[1], u.lodTime / interval);
+}
+
+void SpineSimulation::advance(float dt, Snapshot& out) {
+    for (auto& u : m_units) {
+        if (!u.skeleton && u.asset->state.load() == SpineSkeletonAsset::Ready) instantiate(u);
+    }
+
+    for (auto& u : m_units) u.wasAnimating = u.animating;
+
+    const int count = (int)m_units.size();
+    const int helpers = qMin(m_threadCount.load(), count) - 1;
+
+    if (helpers <= 0) {
+        for (int i = 0; i < count; ++i) updateUnit(m_units[(size_t)i], dt, out.units[(size_t)i]);
+    } else {
+        // Units are claimed from a shared counter, so fast workers pick up the slack
+        // left by heavy skeletons.
+        std::atomic<int> next{0};
+        auto drain = [this, dt, count, &next, &out] {
+            for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+                updateUnit(m_units[(size_t)i], dt, out.units[(size_t)i]);
+        };
+
+        QSemaphore done;
+        for (int h = 0; h < helpers; ++h) {
+            m_pool.start([&drain, &done] {
+                drain();
+                done.release();
+            });
+        }
+        drain();
+        done.acquire(helpers);
+    }
+
+    m_animating = false;
+    out.culledUnits = 0;
+    out.bakedUnits = 0;
+    out.bakedBytes = 0;
+    for (size_t i = 0; i < m_units.size(); ++i) {
+        // A pose only moves while its unit animates (or just stopped doing so).
+        Unit& u = m_units[i];
+        if (u.dirty || u.animating || u.wasAnimating) u.changedStep = m_step + 1;
+        u.dirty = false;
+        out.units[i].changedStep = u.changedStep;
+        out.units[i].lodLevel = out.units[i].culled ? 0 : u.lod;
+
+        m_animating = m_animating || m_units[i].animating;
+        out.culledUnits += out.units[i].culled ? 1 : 0;
+        if (m_units[i].baked) {
+            ++out.bakedUnits;
+            out.bakedBytes += m_units[i].baked->bytes();
+        }
+    }
+
+    out.step = ++m_step;
+}
+
+void SpineSimulation::execute(const SpineCommand& c) {
+    if (c.unit < 0 || c.unit >= int(m_unitOfConfig.size())) return;
+    const int index = m_unitOfConfig[(size_t)c.unit];
+    if (index < 0) return;
+    Unit& u = m_units[(size_t)index];
+
+    if (c.op == SpineCommand::Spawn || c.op == SpineCommand::Despawn) {
+        if (u.pool < 0) return;
+        if (c.op == SpineCommand::Spawn) spawn(u, c.x, c.y);
+        else despawn(u);
+        return;
+    }
+    if (!u.active) return;
+
+    if (!u.skeleton) {
+        if (u.asset->state.load() != SpineSkeletonAsset::Failed) u.deferred.push_back(c);
+        return;
+    }
+    if (u.bake) leaveBaked(u);
+    u.dirty = true;
+
+    const auto& animations = u.asset->animations;
+    spAnimation* anim = (c.animation >= 0 && c.animation < int(animations.size()))
+        ? animations[(size_t)c.animation] : nullptr;
+    if (!anim) return;
+
+    if (c.op == SpineCommand::SetAnimation) spAnimationState_setAnimation(u.state, c.track, anim, c.loop ? 1 : 0);
+    else spAnimationState_addAnimation(u.state, c.track, anim, c.loop ? 1 : 0, c.delay);
+}
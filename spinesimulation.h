@@ -0,0 +1,215 @@
+#pragma once
+#include <QVariantList>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "framearena.h"
+#include "spinecommand.h"
+#include "spinedrawlist.h"
+#include "spinelod.h"
+#include "triplebuffer.h"
+
+class QThread;
+class SpineBakedAnimation;
+struct SpineSkeletonAsset;
+
+// Owns the skeletons and steps them on a dedicated thread at a fixed rate.
+// Each step publishes finished per-unit draw lists through a triple buffer, so the
+// render thread only picks up the newest snapshot and submits GL; a slow frame no
+// longer stalls animation and skeleton work overlaps GPU work.
+class SpineSimulation {
+public:
+    struct Snapshot {
+        std::vector<SpineDrawList> units;   // same order as the configs
+        int culledUnits = 0;                // units entirely outside the view
+        int bakedUnits = 0;                 // units played back from a baked cache
+        qint64 bakedBytes = 0;              // memory held by those caches
+        quint64 step = 0;
+    };
+
+    // How units outside the view are stepped until they come back.
+    enum OffscreenMode {
+        OffscreenFull,      // full update every step; only tessellation is skipped
+        OffscreenReduced,   // whole update once per offscreen interval, with the summed time
+        OffscreenTimeOnly   // track time every step; pose + world transform once per interval
+    };
+
+    // Starts loading every unit through SpineAssetCache (call with a current context);
+    // units join the snapshots as their assets become Ready.
+    // pools: [{name, atlas, skel, scale, defaultAnim, clip, layer, count}]. Each pool
+    // preallocates count skeleton / animation state instances once its asset is Ready;
+    // Spawn commands put an idle instance back in its setup pose and into play, Despawn
+    // returns it. Instances follow the units in Snapshot::units and in unit handles, pool
+    // by pool, and draw nothing while idle.
+    explicit SpineSimulation(const QVariantList& configs, const QVariantList& pools = QVariantList());
+
+    // Instances a pool config asks for. The viewport hands out handles with the same count.
+    static int poolCapacity(const QVariantMap& pool);
+    ~SpineSimulation();
+
+    void start();
+    void stop();
+    // For hosts that drive time themselves instead of start(): one update of dt on the
+    // calling thread, published like a sim step.
+    void step(float dt);
+
+    // Steps per second of simulated time.
+    void setRate(double hz);
+    // Threads used for the per-unit update phase (sim thread included); 0 = auto.
+    void setThreadCount(int threads);
+
+    // Visible area in skeleton coordinates; units and slots outside it are culled.
+    void setView(const SpineDrawList::Bounds& view);
+    // interval: seconds between pose refreshes of an off-screen unit (Reduced/TimeOnly).
+    void setOffscreenMode(OffscreenMode mode, double interval);
+    // Leave weighted meshes to the vertex shader (SpineDrawList skinned batches) instead
+    // of tessellating them here. The renderer turns it off if its skin program fails.
+    void setGpuSkinning(bool enabled);
+    // Vertex layout of the published draw lists; each list records the one it used.
+    void setVertexFormat(SpineDrawList::VertexFormat format);
+    // Level of detail (see SpineLod): -1 picks it per unit from its config "lod" sizes;
+    // 0..2 puts every visible live unit at that level, configured or not (benchmarks).
+    void setLodOverride(int level);
+
+    // Commands are drained from this queue on the sim thread in push order. Set before
+    // start(); the queue may outlive the simulation.
+    void setCommandQueue(std::shared_ptr<SpineCommandQueue> queue) { m_commands = std::move(queue); }
+
+    // Config "layer" of every unit and pool instance, indexed like Snapshot::units ("" when unset).
+    const std::vector<QString>& unitLayers() const { return m_unitLayers; }
+
+    // Render thread: newest published snapshot, valid until the next call.
+    const Snapshot& acquire();
+
+    // True when no track is playing, mixing or queued: the sim thread parks, publishes
+    // nothing new and the last snapshot stays current until a command arrives or a
+    // loading unit becomes ready.
+    bool isIdle() const { return m_idle.load(); }
+    // Called on the sim thread after a publish that leaves or enters idle, so a host
+    // that stopped repainting can draw it. Set before start().
+    void setWakeCallback(std::function<void()> fn) { m_onWake = std::move(fn); }
+
+    struct LoadInfo {
+        QString name;
+        int state = 0;          // SpineSkeletonAsset::State
+        float progress = 0.f;   // 0..1
+    };
+    // Safe from any thread.
+    std::vector<LoadInfo> loadInfo() const;
+
+private:
+    struct BakeJob;
+    struct Unit {
+        QString name;
+        const SpineSkeletonAsset* asset = nullptr;   // shared, owned by SpineAssetCache
+        spSkeleton* skeleton = nullptr;
+        spAnimationState* state = nullptr;
+        float x = 0.f;
+        float y = 0.f;
+        int defaultAnim = -1;   // animation handle
+        std::vector<SpineCommand> deferred;  // commands received before the asset was ready
+
+        // Spawn pool instances: pool index, and whether the instance is in play. Idle
+        // ones keep their skeleton and state for the next Spawn.
+        int pool = -1;
+        bool active = true;
+
+        // Per-unit so units can be tessellated concurrently.
+        spSkeletonClipping* clipper = nullptr;
+        bool stencilClip = false; // clipping attachments go to the stencil instead of clipper
+        FrameArena arena;       // transient world vertices, reset every build
+        bool animating = false; // result of the last update
+        bool wasAnimating = false;  // before the current update
+        bool dirty = true;          // command / view / format change since the last update
+        quint64 changedStep = 0;
+
+        bool visible = true;            // world bounds touched the view at the last pose
+        float offscreenTime = 0.f;      // since the last off-screen pose refresh
+        float offscreenDt = 0.f;        // time owed to a Reduced off-screen unit
+
+        // Baked playback (config bake: true): the default animation's frames come from
+        // a cache instead of the skeleton until a command changes the track. The cache is
+        // built on m_bakers; the unit plays live until it is ready.
+        bool bake = false;
+        float bakeRate = 30.f;
+        std::unique_ptr<SpineBakedAnimation> baked;
+        std::shared_ptr<BakeJob> bakeJob;   // in flight, shared with the task
+        float bakedTime = 0.f;
+
+        // Level of detail (config lod: [size1, size2] in pixels, lodRates: [hz1, hz2]).
+        // Below level 0 the state runs one pose interval ahead and the bones are
+        // blended between the two poses around the current time.
+        float lodSizes[SpineLod::kLevels - 1] = {0.f, 0.f};
+        float lodInterval[SpineLod::kLevels - 1] = {1.f / SpineLod::kDefaultRates[0],
+                                                    1.f / SpineLod::kDefaultRates[1]};
+        float lodSize = std::numeric_limits<float>::infinity();  // larger side at the last build
+        int lod = 0;
+        bool lodPrimed = false;     // lodPose holds a valid pair for the current level
+        float lodTime = 0.f;        // since lodPose[0]
+        std::vector<float> lodPose[2];
+
+        Unit();
+        Unit(Unit&&);
+        ~Unit();
+    };
+
+    std::vector<Unit> m_units;
+    std::vector<int> m_unitOfConfig;    // command unit handle -> m_units index, -1 invalid
+    std::vector<QString> m_unitLayers;
+
+    QThread* m_thread = nullptr;
+    std::atomic<bool> m_stop{false};
+    std::atomic<double> m_rate{60.0};
+
+    QMutex m_mutex;             // guards m_pendingView, pairs with m_wake
+    QWaitCondition m_wake;
+    std::shared_ptr<SpineCommandQueue> m_commands;
+    SpineDrawList::Bounds m_pendingView = SpineDrawList::Bounds::infinite();
+    bool m_viewChanged = false;
+
+    SpineDrawList::Bounds m_view = SpineDrawList::Bounds::infinite();   // sim thread
+    std::atomic<int> m_offscreenMode{OffscreenFull};
+    std::atomic<double> m_offscreenInterval{0.25};
+    std::atomic<bool> m_gpuSkinning{false};
+    std::atomic<int> m_vertexFormat{SpineDrawList::FloatVertex};
+    std::atomic<int> m_lodOverride{-1};
+
+    QThreadPool m_pool;
+    std::atomic<int> m_threadCount{0};
+    QThreadPool m_bakers;       // one thread: bakes never compete with the update workers for long
+
+    TripleBuffer<Snapshot> m_snapshots;
+    quint64 m_step = 0;
+
+    bool m_animating = false;           // sim thread: any unit animating after the last advance
+    std::atomic<bool> m_idle{false};
+    std::function<void()> m_onWake;
+
+    bool configure(Unit& u, const QVariantMap& m);
+    void instantiate(Unit& u);
+    void resetPose(Unit& u);
+    void spawn(Unit& u, float x, float y);
+    void despawn(Unit& u);
+    void run();
+    bool applyPendingCommands();
+    void advance(float dt, Snapshot& out);
+    void updateUnit(Unit& u, float dt, SpineDrawList& out);
+    int lodLevel(const Unit& u) const;
+    void poseLod(Unit& u, float dt, float ahead);
+    bool applyPendingView();
+    void requestRebuild();
+    static bool isAnimating(const spAnimationState* state);
+    bool hasInstantiableUnits() const;
+    bool hasLoadingUnits() const;
+
+    void execute(const SpineCommand& c);
+    void startBake(Unit& u);
+    void pollBake(Unit& u);
+    void leaveBaked(Unit& u);
+};
@@ -0,0 +1,98 @@
+#include "spineskinning.h"
+
+#include <QHash>
+#include <cmath>
+
+namespace {
+bool convert(const spMeshAttachment* att, SpineSkinnedMesh& out) {
+    const spVertexAttachment& va = att->super;
+    if (!va.bones || !att->uvs || !att->triangles || att->trianglesCount <= 0) return false;
+
+    // Weighted layout: bones = [n, bone...] per vertex, vertices = (x, y, weight) per bone.
+    const int vertexCount = va.worldVerticesLength / 2;
+    out.verts.resize((size_t)vertexCount);
+    QHash<int, float> reach;
+
+    int v = 0;
+    int b = 0;
+    for (int i = 0; i < vertexCount; ++i) {
+        if (v >= va.bonesCount) return false;
+        const int n = va.bones[v++];
+        if (n > SpineSkinning::kMaxInfluences || v + n > va.bonesCount || (b + n) * 3 > va.verticesCount)
+            return false;
+
+        SpineSkinnedMesh::Vtx& o = out.verts[(size_t)i];
+        o = SpineSkinnedMesh::Vtx{};
+        o.u = att->uvs[i * 2 + 0];
+        o.v = att->uvs[i * 2 + 1];
+        for (int k = 0; k < n; ++k, ++v, ++b) {
+            const int bone = va.bones[v];
+            const float x = va.vertices[b * 3 + 0];
+            const float y = va.vertices[b * 3 + 1];
+            o.bone[k] = float(bone);
+            o.localX[k] = x;
+            o.localY[k] = y;
+            o.weight[k] = va.vertices[b * 3 + 2];
+            reach[bone] = qMax(reach.value(bone, 0.f), std::sqrt(x * x + y * y));
+        }
+    }
+
+    out.indices.assign(att->triangles, att->triangles + att->trianglesCount);
+    for (auto it = reach.constBegin(); it != reach.constEnd(); ++it)
+        out.boneReach.emplace_back(it.key(), it.value());
+    return true;
+}
+
+void collect(const spSkeletonData* data, const spSkin* skin, SpineSkinnedMeshes& out) {
+    if (!skin) return;
+    for (int slot = 0; slot < data->slotsCount; ++slot) {
+        for (int i = 0;; ++i) {
+            const char* name = spSkin_getAttachmentName(skin, slot, i);
+            if (!name) break;
+            const spAttachment* a = spSkin_getAttachment(skin, slot, name);
+            if (!a || a->type != SP_ATTACHMENT_MESH || out.count(a)) continue;
+
+            SpineSkinnedMesh mesh;
+            if (convert(reinterpret_cast<const spMeshAttachment*>(a), mesh)) out.emplace(a, std::move(mesh));
+        }
+    }
+}
+}
+
+SpineSkinnedMeshes SpineSkinning::prepare(const spSkeletonData* data) {
+    SpineSkinnedMeshes out;
+    if (!data || data->bonesCount > kMaxBones) return out;
+    collect(data, data->defaultSkin, out);
+    for (int i = 0; i < data->skinsCount; ++i) collect(data, data->skins[i], out);
+    return out;
+}
+
+SpineDrawList::Bounds SpineSkinning::bounds(const SpineSkinnedMesh& mesh, const spSkeleton* skeleton) {
+    // Each vertex is a weighted average of points inside its bones' transformed discs,
+    // so the union of those discs' boxes contains it.
+    SpineDrawList::Bounds out;
+    for (const auto& br : mesh.boneReach) {
+        const spBone* bone = skeleton->bones[br.first];
+        const float rx = br.second * std::sqrt(bone->a * bone->a + bone->b * bone->b);
+        const float ry = br.second * std::sqrt(bone->c * bone->c + bone->d * bone->d);
+        out.add(SpineDrawList::Bounds{bone->worldX - rx, bone->worldY - ry, bone->worldX + rx, bone->worldY + ry});
+    }
+    return out;
+}
+
+void SpineSkinning::writeBones(const spSkeleton* skeleton, std::vector<float>& out) {
+    const size_t base = out.size();
+    out.resize(base + size_t(skeleton->bonesCount) * kFloatsPerBone);
+    float* dst = out.data() + base;
+    for (int i = 0; i < skeleton->bonesCount; ++i, dst += kFloatsPerBone) {
+        const spBone* bone = skeleton->bones[i];
+        dst[0] = bone->a;
+        dst[1] = bone->b;
+        dst[2] = bone->worldX;
+        dst[3] = 0.f;
+        dst[4] = bone->c;
+        dst[5] = bone->d;
+        dst[6] = bone->worldY;
+        dst[7] = 0.f;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "spinedrawlist.h"
+
+// Load-time data for drawing one weighted mesh with GPU skinning. Everything here is
+// fixed by the skeleton data; per frame only the bone matrices change.
+struct SpineSkinnedMesh {
+    // Up to four influences per vertex: skeleton bone index (as float), bone-local
+    // position and weight. Unused influences have weight 0.
+    struct Vtx {
+        float u, v;
+        float bone[4];
+        float weight[4];
+        float localX[4];
+        float localY[4];
+    };
+
+    std::vector<Vtx> verts;
+    std::vector<unsigned short> indices;
+    // (bone, furthest local position) for every influencing bone; gives a conservative
+    // world AABB from the bone transforms alone.
+    std::vector<std::pair<int, float>> boneReach;
+};
+
+class SpineSkinning {
+public:
+    // Limits of the GPU path; meshes or skeletons beyond them stay on the CPU.
+    static constexpr int kMaxBones = 256;       // largest skin tier: 2 * kMaxBones vec4 (8 KB)
+    static constexpr int kMaxInfluences = 4;
+    static constexpr int kFloatsPerBone = 8;    // (a, b, worldX, 0), (c, d, worldY, 0)
+
+    // Loader thread: every weighted mesh of every skin that fits the limits.
+    static SpineSkinnedMeshes prepare(const spSkeletonData* data);
+
+    // World AABB containing the mesh for the skeleton's current pose.
+    static SpineDrawList::Bounds bounds(const SpineSkinnedMesh& mesh, const spSkeleton* skeleton);
+
+    // Appends the pose's bone matrices, kFloatsPerBone each, in skeleton bone order.
+    static void writeBones(const spSkeleton* skeleton, std::vector<float>& out);
+};
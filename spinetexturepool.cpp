@@ -0,0 +1,155 @@
+#include "spinetexturepool.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QOpenGLContext>
+#include <algorithm>
+
+bool SpineTexturePool::enabled() {
+    static const bool on = qEnvironmentVariableIntValue("SGS_SPINE_TEXTURE_POOL") != 0;
+    return on;
+}
+
+SpineTexturePool::~SpineTexturePool() {
+    // Arrays go with their last page, so anything left here belongs to leaked atlases.
+    if (!m_arrays.empty()) qWarning() << "[SpineTexturePool] destroyed with" << m_arrays.size() << "arrays in use";
+}
+
+bool SpineTexturePool::place(SpinePageTexture* page, int width, int height, QOpenGLExtraFunctions* gl) {
+    QMutexLocker lock(&m_mutex);
+    if (m_maxLayers == 0) {
+        gl->glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &m_maxLayers);
+        // PackedVertex carries the layer in one byte.
+        m_maxLayers = qBound<GLint>(1, m_maxLayers, kMaxLayers);
+    }
+    // SGS_SPINE_TEXTURE_POOL_BUDGET=n refuses pages beyond n per pool, so the unplaced
+    // page path can be exercised without running GL out of memory.
+    static const int budget = qEnvironmentVariableIntValue("SGS_SPINE_TEXTURE_POOL_BUDGET");
+    if (budget > 0) {
+        int placed = 0;
+        for (const auto& a : m_arrays) placed += int(std::count(a->m_used.begin(), a->m_used.end(), true));
+        if (placed >= budget) {
+            qWarning() << "[SpineTexturePool] budget of" << budget << "pages reached; page not placed";
+            return false;
+        }
+    }
+
+    SpineTextureArray* target = nullptr;
+    int layer = -1;
+    for (const auto& a : m_arrays) {
+        if (a->m_width != width || a->m_height != height) continue;
+        const auto free = std::find(a->m_used.begin(), a->m_used.end(), false);
+        if (free != a->m_used.end()) {
+            target = a.get();
+            layer = int(free - a->m_used.begin());
+            break;
+        }
+        if (a->m_capacity < m_maxLayers) {
+            target = a.get();
+            layer = a->m_capacity;
+            if (!grow(target, qMin<int>(m_maxLayers, a->m_capacity * 2), gl)) return false;
+            break;
+        }
+    }
+    if (!target) {
+        std::unique_ptr<SpineTextureArray> a(new SpineTextureArray);
+        a->m_pool = this;
+        a->m_width = width;
+        a->m_height = height;
+        if (!grow(a.get(), qMin<int>(m_maxLayers, kInitialLayers), gl)) return false;
+        target = a.get();
+        layer = 0;
+        m_arrays.push_back(std::move(a));
+    }
+
+    target->m_used[size_t(layer)] = true;
+    page->array = target;
+    page->layer = layer;
+    gl->glBindTexture(GL_TEXTURE_2D_ARRAY, target->m_id);
+    return true;
+}
+
+// Re-specifies the array at capacity layers under a fresh id and blits the old layers
+// over, so pages already drawn from it keep their contents.
+bool SpineTexturePool::grow(SpineTextureArray* array, int capacity, QOpenGLExtraFunctions* gl) {
+    GLuint id = 0;
+    gl->glGenTextures(1, &id);
+    gl->glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+    // Errors left by Qt Quick or earlier GL calls would fail the check below.
+    while (gl->glGetError() != GL_NO_ERROR) {}
+    gl->glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, array->m_width, array->m_height, capacity, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    if (gl->glGetError() != GL_NO_ERROR) {
+        qWarning() << "[SpineTexturePool] cannot allocate" << array->m_width << "x" << array->m_height
+                   << "x" << capacity << "array";
+        gl->glDeleteTextures(1, &id);
+        return false;
+    }
+    gl->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+    gl->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gl->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    if (array->m_id) {
+        GLint readFbo = 0;
+        GLint drawFbo = 0;
+        gl->glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFbo);
+        gl->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFbo);
+        GLboolean scissor = gl->glIsEnabled(GL_SCISSOR_TEST);
+        gl->glDisable(GL_SCISSOR_TEST);
+
+        GLuint fbos[2] = {0, 0};
+        gl->glGenFramebuffers(2, fbos);
+        gl->glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos[0]);
+        gl->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[1]);
+        for (int layer = 0; layer < array->m_capacity; ++layer) {
+            if (!array->m_used[size_t(layer)]) continue;
+            gl->glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, array->m_id, 0, layer);
+            gl->glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, id, 0, layer);
+            gl->glBlitFramebuffer(0, 0, array->m_width, array->m_height, 0, 0, array->m_width, array->m_height,
+                                  GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        gl->glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(readFbo));
+        gl->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(drawFbo));
+        gl->glDeleteFramebuffers(2, fbos);
+        if (scissor) gl->glEnable(GL_SCISSOR_TEST);
+
+        gl->glDeleteTextures(1, &array->m_id);
+        ++m_grows;
+    }
+
+    array->m_id = id;
+    array->m_capacity = capacity;
+    array->m_used.resize(size_t(capacity), false);
+    return true;
+}
+
+void SpineTexturePool::release(SpinePageTexture* page) {
+    SpineTextureArray* array = page->array;
+    if (!array) return;
+    page->array = nullptr;
+
+    SpineTexturePool* pool = array->m_pool;
+    QMutexLocker lock(&pool->m_mutex);
+    array->m_used[size_t(page->layer)] = false;
+    if (std::find(array->m_used.begin(), array->m_used.end(), true) != array->m_used.end()) return;
+
+    if (QOpenGLContext* ctx = QOpenGLContext::currentContext()) ctx->functions()->glDeleteTextures(1, &array->m_id);
+    const auto it = std::find_if(pool->m_arrays.begin(), pool->m_arrays.end(),
+                                 [array](const auto& a) { return a.get() == array; });
+    if (it != pool->m_arrays.end()) pool->m_arrays.erase(it);
+}
+
+SpineTexturePool::Stats SpineTexturePool::stats() const {
+    QMutexLocker lock(&m_mutex);
+    Stats s;
+    s.grows = m_grows;
+    for (const auto& a : m_arrays) {
+        ++s.arrays;
+        s.layers += int(std::count(a->m_used.begin(), a->m_used.end(), true));
+        s.capacity += a->m_capacity;
+        s.bytes += qint64(a->m_width) * a->m_height * 4 * a->m_capacity;
+    }
+    return s;
+}
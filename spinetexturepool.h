@@ -0,0 +1,76 @@
+#pragma once
+#include <QMutex>
+#include <QOpenGLExtraFunctions>
+#include <memory>
+#include <vector>
+
+class QOpenGLTexture;
+class SpineTexturePool;
+
+// One GL_TEXTURE_2D_ARRAY of equally sized atlas pages. Owned by its pool; the address
+// is stable, the texture id changes when the array grows.
+class SpineTextureArray {
+public:
+    GLuint textureId() const { return m_id; }
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+private:
+    friend class SpineTexturePool;
+    SpineTexturePool* m_pool = nullptr;
+    GLuint m_id = 0;
+    int m_width = 0;
+    int m_height = 0;
+    int m_capacity = 0;             // layers allocated in GL
+    std::vector<bool> m_used;       // per allocated layer
+};
+
+// What spAtlasPage::rendererObject points to. A standalone page owns a 2D texture; a
+// pooled page is one layer of a shared array, so slots of different pages and atlases
+// can share a batch. Filled on the render thread when the page's upload starts.
+struct SpinePageTexture {
+    QOpenGLTexture* texture = nullptr;
+    SpineTextureArray* array = nullptr;
+    int layer = 0;
+};
+
+// Texture pool mode (SGS_SPINE_TEXTURE_POOL=1): every atlas page of one share group goes
+// into a layer of a 2D array holding pages of the same size. Arrays start at a few
+// layers and double (copying the old layers on the GPU) until the GL layer limit, then
+// a further array is started for that size.
+class SpineTexturePool {
+public:
+    struct Stats {
+        int arrays = 0;
+        int layers = 0;             // pages placed
+        int capacity = 0;           // layers allocated
+        qint64 bytes = 0;           // GL memory of the arrays
+        int grows = 0;
+    };
+
+    static bool enabled();
+
+    ~SpineTexturePool();
+
+    // Render thread with a context of the pool's group current. Puts a width x height
+    // page into a free layer, growing or adding an array as needed, and binds that
+    // array to GL_TEXTURE_2D_ARRAY. False if GL refused the storage or the budget
+    // (SGS_SPINE_TEXTURE_POOL_BUDGET) is spent; the page keeps no texture.
+    bool place(SpinePageTexture* page, int width, int height, QOpenGLExtraFunctions* gl);
+    // Needs a context of the group current; frees the page's layer and, with it the
+    // array's last, the array itself.
+    static void release(SpinePageTexture* page);
+
+    Stats stats() const;
+
+private:
+    bool grow(SpineTextureArray* array, int capacity, QOpenGLExtraFunctions* gl);
+
+    static constexpr int kInitialLayers = 4;
+    static constexpr int kMaxLayers = 256;
+
+    mutable QMutex m_mutex;
+    std::vector<std::unique_ptr<SpineTextureArray>> m_arrays;
+    GLint m_maxLayers = 0;
+    int m_grows = 0;
+};
@@ -0,0 +1,416 @@
+#include "spinevertexkernels.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QtGlobal>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define SGS_SIMD_X86 1
+#  include <immintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  endif
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define SGS_SIMD_SSE2 1
+#  endif
+// GCC/Clang compile the AVX2 functions for that target only; MSVC needs no flag.
+#  if defined(__GNUC__) || defined(__clang__)
+#    define SGS_TARGET_AVX2 __attribute__((target("avx2")))
+#  else
+#    define SGS_TARGET_AVX2
+#  endif
+#  define SGS_SIMD_AVX2 1
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#  define SGS_SIMD_NEON 1
+#  include <arm_neon.h>
+#endif
+
+namespace {
+
+// ---- scalar reference ------------------------------------------------------------
+
+inline void widen(float* box, float x, float y) {
+    box[0] = qMin(box[0], x);
+    box[1] = qMin(box[1], y);
+    box[2] = qMax(box[2], x);
+    box[3] = qMax(box[3], y);
+}
+
+void transformScalar(const float* local, int count, const float* m, float* outXY, float* box) {
+    for (int i = 0; i < count; ++i) {
+        const float lx = local[i*2+0];
+        const float ly = local[i*2+1];
+        const float wx = lx * m[0] + ly * m[1] + m[4];
+        const float wy = lx * m[2] + ly * m[3] + m[5];
+        outXY[i*2+0] = wx;
+        outXY[i*2+1] = wy;
+        widen(box, wx, wy);
+    }
+}
+
+void interleaveScalar(const float* xy, const float* uv, int count, const float* color, float* out) {
+    for (int i = 0; i < count; ++i, out += 8) {
+        out[0] = xy[i*2+0];
+        out[1] = xy[i*2+1];
+        out[2] = uv[i*2+0];
+        out[3] = uv[i*2+1];
+        out[4] = color[0];
+        out[5] = color[1];
+        out[6] = color[2];
+        out[7] = color[3];
+    }
+}
+
+void transformInterleaveScalar(const float* local, const float* uv, int count, const float* m,
+                               const float* color, float* out, float* box)
+{
+    for (int i = 0; i < count; ++i, out += 8) {
+        const float lx = local[i*2+0];
+        const float ly = local[i*2+1];
+        out[0] = lx * m[0] + ly * m[1] + m[4];
+        out[1] = lx * m[2] + ly * m[3] + m[5];
+        out[2] = uv[i*2+0];
+        out[3] = uv[i*2+1];
+        out[4] = color[0];
+        out[5] = color[1];
+        out[6] = color[2];
+        out[7] = color[3];
+        widen(box, out[0], out[1]);
+    }
+}
+
+// ---- SSE2: two vertices per register ---------------------------------------------
+
+#if SGS_SIMD_SSE2
+struct Sse2Affine {
+    __m128 ac, bd, t;
+    explicit Sse2Affine(const float* m)
+        : ac(_mm_setr_ps(m[0], m[2], m[0], m[2]))
+        , bd(_mm_setr_ps(m[1], m[3], m[1], m[3]))
+        , t(_mm_setr_ps(m[4], m[5], m[4], m[5])) {}
+    // p = (x0, y0, x1, y1) local -> world, same operation order as the scalar path.
+    __m128 apply(__m128 p) const {
+        const __m128 xs = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+        const __m128 ys = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(xs, ac), _mm_mul_ps(ys, bd)), t);
+    }
+};
+
+inline void storeBox(float* box, __m128 vmin, __m128 vmax) {
+    vmin = _mm_min_ps(vmin, _mm_movehl_ps(vmin, vmin));
+    vmax = _mm_max_ps(vmax, _mm_movehl_ps(vmax, vmax));
+    _mm_storel_pi(reinterpret_cast<__m64*>(box), vmin);
+    _mm_storel_pi(reinterpret_cast<__m64*>(box + 2), vmax);
+}
+
+void transformSse2(const float* local, int count, const float* m, float* outXY, float* box) {
+    const Sse2Affine affine(m);
+    __m128 vmin = _mm_setr_ps(box[0], box[1], box[0], box[1]);
+    __m128 vmax = _mm_setr_ps(box[2], box[3], box[2], box[3]);
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const __m128 w = affine.apply(_mm_loadu_ps(local + i*2));
+        _mm_storeu_ps(outXY + i*2, w);
+        vmin = _mm_min_ps(vmin, w);
+        vmax = _mm_max_ps(vmax, w);
+    }
+    storeBox(box, vmin, vmax);
+    transformScalar(local + i*2, count - i, m, outXY + i*2, box);
+}
+
+void interleaveSse2(const float* xy, const float* uv, int count, const float* color, float* out) {
+    const __m128 c = _mm_loadu_ps(color);
+    int i = 0;
+    for (; i + 2 <= count; i += 2, out += 16) {
+        const __m128 p = _mm_loadu_ps(xy + i*2);
+        const __m128 t = _mm_loadu_ps(uv + i*2);
+        _mm_storeu_ps(out + 0, _mm_movelh_ps(p, t));    // x0 y0 u0 v0
+        _mm_storeu_ps(out + 4, c);
+        _mm_storeu_ps(out + 8, _mm_movehl_ps(t, p));    // x1 y1 u1 v1
+        _mm_storeu_ps(out + 12, c);
+    }
+    interleaveScalar(xy + i*2, uv + i*2, count - i, color, out);
+}
+
+void transformInterleaveSse2(const float* local, const float* uv, int count, const float* m,
+                             const float* color, float* out, float* box)
+{
+    const Sse2Affine affine(m);
+    const __m128 c = _mm_loadu_ps(color);
+    __m128 vmin = _mm_setr_ps(box[0], box[1], box[0], box[1]);
+    __m128 vmax = _mm_setr_ps(box[2], box[3], box[2], box[3]);
+    int i = 0;
+    for (; i + 2 <= count; i += 2, out += 16) {
+        const __m128 w = affine.apply(_mm_loadu_ps(local + i*2));
+        const __m128 t = _mm_loadu_ps(uv + i*2);
+        _mm_storeu_ps(out + 0, _mm_movelh_ps(w, t));
+        _mm_storeu_ps(out + 4, c);
+        _mm_storeu_ps(out + 8, _mm_movehl_ps(t, w));
+        _mm_storeu_ps(out + 12, c);
+        vmin = _mm_min_ps(vmin, w);
+        vmax = _mm_max_ps(vmax, w);
+    }
+    storeBox(box, vmin, vmax);
+    transformInterleaveScalar(local + i*2, uv + i*2, count - i, m, color, out, box);
+}
+#endif
+
+// ---- AVX2: four vertices per register --------------------------------------------
+
+#if SGS_SIMD_AVX2
+struct Avx2Affine {
+    __m256 ac, bd, t;
+    SGS_TARGET_AVX2 explicit Avx2Affine(const float* m)
+        : ac(_mm256_setr_ps(m[0], m[2], m[0], m[2], m[0], m[2], m[0], m[2]))
+        , bd(_mm256_setr_ps(m[1], m[3], m[1], m[3], m[1], m[3], m[1], m[3]))
+        , t(_mm256_setr_ps(m[4], m[5], m[4], m[5], m[4], m[5], m[4], m[5])) {}
+    SGS_TARGET_AVX2 __m256 apply(__m256 p) const {
+        const __m256 xs = _mm256_permute_ps(p, _MM_SHUFFLE(2, 2, 0, 0));
+        const __m256 ys = _mm256_permute_ps(p, _MM_SHUFFLE(3, 3, 1, 1));
+        return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(xs, ac), _mm256_mul_ps(ys, bd)), t);
+    }
+};
+
+SGS_TARGET_AVX2 inline void storeBoxAvx2(float* box, __m256 vmin, __m256 vmax) {
+    __m128 lo = _mm_min_ps(_mm256_castps256_ps128(vmin), _mm256_extractf128_ps(vmin, 1));
+    __m128 hi = _mm_max_ps(_mm256_castps256_ps128(vmax), _mm256_extractf128_ps(vmax, 1));
+    lo = _mm_min_ps(lo, _mm_movehl_ps(lo, lo));
+    hi = _mm_max_ps(hi, _mm_movehl_ps(hi, hi));
+    _mm_storel_pi(reinterpret_cast<__m64*>(box), lo);
+    _mm_storel_pi(reinterpret_cast<__m64*>(box + 2), hi);
+}
+
+// a/b = (x y u v) of vertices {0, 2} / {1, 3} per 128-bit lane; c = color in both lanes.
+SGS_TARGET_AVX2 inline void storeFour(float* out, __m256 a, __m256 b, __m256 c) {
+    _mm256_storeu_ps(out + 0, _mm256_permute2f128_ps(a, c, 0x20));
+    _mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(b, c, 0x20));
+    _mm256_storeu_ps(out + 16, _mm256_permute2f128_ps(a, c, 0x31));
+    _mm256_storeu_ps(out + 24, _mm256_permute2f128_ps(b, c, 0x31));
+}
+
+SGS_TARGET_AVX2 void transformAvx2(const float* local, int count, const float* m, float* outXY, float* box) {
+    const Avx2Affine affine(m);
+    __m256 vmin = _mm256_setr_ps(box[0], box[1], box[0], box[1], box[0], box[1], box[0], box[1]);
+    __m256 vmax = _mm256_setr_ps(box[2], box[3], box[2], box[3], box[2], box[3], box[2], box[3]);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256 w = affine.apply(_mm256_loadu_ps(local + i*2));
+        _mm256_storeu_ps(outXY + i*2, w);
+        vmin = _mm256_min_ps(vmin, w);
+        vmax = _mm256_max_ps(vmax, w);
+    }
+    storeBoxAvx2(box, vmin, vmax);
+    _mm256_zeroupper();     // the tail is non-VEX code; GCC skips this on a tail call
+    transformScalar(local + i*2, count - i, m, outXY + i*2, box);
+}
+
+SGS_TARGET_AVX2 void interleaveAvx2(const float* xy, const float* uv, int count, const float* color, float* out) {
+    const __m128 c4 = _mm_loadu_ps(color);
+    const __m256 c = _mm256_insertf128_ps(_mm256_castps128_ps256(c4), c4, 1);
+    int i = 0;
+    for (; i + 4 <= count; i += 4, out += 32) {
+        const __m256 p = _mm256_loadu_ps(xy + i*2);
+        const __m256 t = _mm256_loadu_ps(uv + i*2);
+        storeFour(out, _mm256_shuffle_ps(p, t, _MM_SHUFFLE(1, 0, 1, 0)),
+                       _mm256_shuffle_ps(p, t, _MM_SHUFFLE(3, 2, 3, 2)), c);
+    }
+    _mm256_zeroupper();
+    interleaveScalar(xy + i*2, uv + i*2, count - i, color, out);
+}
+
+SGS_TARGET_AVX2 void transformInterleaveAvx2(const float* local, const float* uv, int count, const float* m,
+                                             const float* color, float* out, float* box)
+{
+    const Avx2Affine affine(m);
+    const __m128 c4 = _mm_loadu_ps(color);
+    const __m256 c = _mm256_insertf128_ps(_mm256_castps128_ps256(c4), c4, 1);
+    __m256 vmin = _mm256_setr_ps(box[0], box[1], box[0], box[1], box[0], box[1], box[0], box[1]);
+    __m256 vmax = _mm256_setr_ps(box[2], box[3], box[2], box[3], box[2], box[3], box[2], box[3]);
+    int i = 0;
+    for (; i + 4 <= count; i += 4, out += 32) {
+        const __m256 w = affine.apply(_mm256_loadu_ps(local + i*2));
+        const __m256 t = _mm256_loadu_ps(uv + i*2);
+        storeFour(out, _mm256_shuffle_ps(w, t, _MM_SHUFFLE(1, 0, 1, 0)),
+                       _mm256_shuffle_ps(w, t, _MM_SHUFFLE(3, 2, 3, 2)), c);
+        vmin = _mm256_min_ps(vmin, w);
+        vmax = _mm256_max_ps(vmax, w);
+    }
+    storeBoxAvx2(box, vmin, vmax);
+    _mm256_zeroupper();
+    transformInterleaveScalar(local + i*2, uv + i*2, count - i, m, color, out, box);
+}
+
+bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;   // OS saves YMM state
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// ---- NEON (AArch64): four vertices per register ----------------------------------
+
+#if SGS_SIMD_NEON
+inline void transformNeon4(const float* local, const float* m, float32x4_t& wx, float32x4_t& wy) {
+    const float32x4x2_t p = vld2q_f32(local);   // deinterleave: val[0] = x, val[1] = y
+    wx = vaddq_f32(vaddq_f32(vmulq_n_f32(p.val[0], m[0]), vmulq_n_f32(p.val[1], m[1])), vdupq_n_f32(m[4]));
+    wy = vaddq_f32(vaddq_f32(vmulq_n_f32(p.val[0], m[2]), vmulq_n_f32(p.val[1], m[3])), vdupq_n_f32(m[5]));
+}
+
+inline void storeFourNeon(float* out, float32x4_t xy01, float32x4_t xy23,
+                          float32x4_t uv01, float32x4_t uv23, float32x4_t c)
+{
+    vst1q_f32(out + 0,  vcombine_f32(vget_low_f32(xy01), vget_low_f32(uv01)));
+    vst1q_f32(out + 4,  c);
+    vst1q_f32(out + 8,  vcombine_f32(vget_high_f32(xy01), vget_high_f32(uv01)));
+    vst1q_f32(out + 12, c);
+    vst1q_f32(out + 16, vcombine_f32(vget_low_f32(xy23), vget_low_f32(uv23)));
+    vst1q_f32(out + 20, c);
+    vst1q_f32(out + 24, vcombine_f32(vget_high_f32(xy23), vget_high_f32(uv23)));
+    vst1q_f32(out + 28, c);
+}
+
+inline void widenNeon(float* box, float32x4_t minX, float32x4_t minY, float32x4_t maxX, float32x4_t maxY) {
+    box[0] = vminvq_f32(minX);
+    box[1] = vminvq_f32(minY);
+    box[2] = vmaxvq_f32(maxX);
+    box[3] = vmaxvq_f32(maxY);
+}
+
+void transformNeon(const float* local, int count, const float* m, float* outXY, float* box) {
+    float32x4_t minX = vdupq_n_f32(box[0]), minY = vdupq_n_f32(box[1]);
+    float32x4_t maxX = vdupq_n_f32(box[2]), maxY = vdupq_n_f32(box[3]);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t wx, wy;
+        transformNeon4(local + i*2, m, wx, wy);
+        float32x4x2_t w;
+        w.val[0] = wx;
+        w.val[1] = wy;
+        vst2q_f32(outXY + i*2, w);
+        minX = vminq_f32(minX, wx); maxX = vmaxq_f32(maxX, wx);
+        minY = vminq_f32(minY, wy); maxY = vmaxq_f32(maxY, wy);
+    }
+    widenNeon(box, minX, minY, maxX, maxY);
+    transformScalar(local + i*2, count - i, m, outXY + i*2, box);
+}
+
+void interleaveNeon(const float* xy, const float* uv, int count, const float* color, float* out) {
+    const float32x4_t c = vld1q_f32(color);
+    int i = 0;
+    for (; i + 4 <= count; i += 4, out += 32) {
+        storeFourNeon(out, vld1q_f32(xy + i*2), vld1q_f32(xy + i*2 + 4),
+                      vld1q_f32(uv + i*2), vld1q_f32(uv + i*2 + 4), c);
+    }
+    interleaveScalar(xy + i*2, uv + i*2, count - i, color, out);
+}
+
+void transformInterleaveNeon(const float* local, const float* uv, int count, const float* m,
+                             const float* color, float* out, float* box)
+{
+    const float32x4_t c = vld1q_f32(color);
+    float32x4_t minX = vdupq_n_f32(box[0]), minY = vdupq_n_f32(box[1]);
+    float32x4_t maxX = vdupq_n_f32(box[2]), maxY = vdupq_n_f32(box[3]);
+    int i = 0;
+    for (; i + 4 <= count; i += 4, out += 32) {
+        float32x4_t wx, wy;
+        transformNeon4(local + i*2, m, wx, wy);
+        storeFourNeon(out, vzip1q_f32(wx, wy), vzip2q_f32(wx, wy),
+                      vld1q_f32(uv + i*2), vld1q_f32(uv + i*2 + 4), c);
+        minX = vminq_f32(minX, wx); maxX = vmaxq_f32(maxX, wx);
+        minY = vminq_f32(minY, wy); maxY = vmaxq_f32(maxY, wy);
+    }
+    widenNeon(box, minX, minY, maxX, maxY);
+    transformInterleaveScalar(local + i*2, uv + i*2, count - i, m, color, out, box);
+}
+#endif
+
+const SpineVertexKernels::Table kScalar{
+    SpineVertexKernels::Scalar, "scalar", transformScalar, interleaveScalar, transformInterleaveScalar
+};
+#if SGS_SIMD_SSE2
+const SpineVertexKernels::Table kSse2{
+    SpineVertexKernels::Sse2, "sse2", transformSse2, interleaveSse2, transformInterleaveSse2
+};
+#endif
+#if SGS_SIMD_AVX2
+const SpineVertexKernels::Table kAvx2{
+    SpineVertexKernels::Avx2, "avx2", transformAvx2, interleaveAvx2, transformInterleaveAvx2
+};
+#endif
+#if SGS_SIMD_NEON
+const SpineVertexKernels::Table kNeon{
+    SpineVertexKernels::Neon, "neon", transformNeon, interleaveNeon, transformInterleaveNeon
+};
+#endif
+
+const SpineVertexKernels::Table& pick() {
+    const QByteArray forced = qgetenv("SGS_SPINE_SIMD").toLower();
+    if (!forced.isEmpty()) {
+        for (int isa = 0; isa < SpineVertexKernels::IsaCount; ++isa) {
+            const auto& t = SpineVertexKernels::table(SpineVertexKernels::Isa(isa));
+            if (t.isa == isa && forced == t.name) return t;
+        }
+        qWarning() << "[SpineVertexKernels] SGS_SPINE_SIMD" << forced << "not available here";
+    }
+    for (int isa : {SpineVertexKernels::Avx2, SpineVertexKernels::Neon, SpineVertexKernels::Sse2}) {
+        if (SpineVertexKernels::supported(SpineVertexKernels::Isa(isa)))
+            return SpineVertexKernels::table(SpineVertexKernels::Isa(isa));
+    }
+    return kScalar;
+}
+}
+
+bool SpineVertexKernels::supported(Isa isa) {
+    switch (isa) {
+    case Scalar: return true;
+#if SGS_SIMD_SSE2
+    case Sse2: return true;
+#endif
+#if SGS_SIMD_AVX2
+    case Avx2: {
+        static const bool avx2 = cpuHasAvx2();
+        return avx2;
+    }
+#endif
+#if SGS_SIMD_NEON
+    case Neon: return true;
+#endif
+    default: return false;
+    }
+}
+
+const SpineVertexKernels::Table& SpineVertexKernels::table(Isa isa) {
+    if (!supported(isa)) return kScalar;
+    switch (isa) {
+#if SGS_SIMD_SSE2
+    case Sse2: return kSse2;
+#endif
+#if SGS_SIMD_AVX2
+    case Avx2: return kAvx2;
+#endif
+#if SGS_SIMD_NEON
+    case Neon: return kNeon;
+#endif
+    default: return kScalar;
+    }
+}
+
+const SpineVertexKernels::Table& SpineVertexKernels::scalar() {
+    return kScalar;
+}
+
+const SpineVertexKernels::Table& SpineVertexKernels::active() {
+    static const Table& chosen = pick();
+    return chosen;
+}
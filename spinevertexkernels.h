@@ -0,0 +1,37 @@
+#pragma once
+
+// Inner loops of draw-list building, with SSE2 / AVX2 / NEON versions picked at runtime.
+// The scalar table is the reference: every other table must produce the same floats
+// (same operation order, no FMA: the file is built with -ffp-contract=off, see
+// CMakeLists.txt), which SgsSpineKernelBench checks.
+//
+// Conventions shared by all kernels:
+//   m     bone affine {a, b, c, d, worldX, worldY}; world = (x*a + y*b + worldX, x*c + y*d + worldY)
+//   box   running {minX, minY, maxX, maxY}, widened by the points written
+//   out   SpineDrawList::Vtx records, 8 floats each: x, y, u, v, r, g, b, a
+class SpineVertexKernels {
+public:
+    enum Isa { Scalar, Sse2, Avx2, Neon, IsaCount };
+
+    using TransformFn = void (*)(const float* local, int count, const float* m, float* outXY, float* box);
+    using InterleaveFn = void (*)(const float* xy, const float* uv, int count, const float* color, float* out);
+    using TransformInterleaveFn = void (*)(const float* local, const float* uv, int count, const float* m,
+                                           const float* color, float* out, float* box);
+
+    struct Table {
+        Isa isa;
+        const char* name;
+        TransformFn transform;                      // unweighted vertices -> world xy
+        InterleaveFn interleave;                    // world xy + uv + color -> Vtx
+        TransformInterleaveFn transformInterleave;  // both in one pass, no xy scratch
+    };
+
+    // Best table this CPU supports. SGS_SPINE_SIMD=scalar|sse2|avx2|neon forces one
+    // (ignored if unsupported). Chosen once, thread-safe.
+    static const Table& active();
+    static const Table& scalar();
+
+    static bool supported(Isa isa);
+    // The table for isa, or the scalar one when this build/CPU lacks it.
+    static const Table& table(Isa isa);
+};
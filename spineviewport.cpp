@@ -1,19 +1,37 @@
 #include "spineviewport.h"
 #include "spinerenderer.h"
 
-SpineViewport::SpineViewport() { setMirrorVertically(true); }
+#include <QQuickFramebufferObject>
 
-QQuickFramebufferObject::Renderer* SpineViewport::createRenderer() const {
-    return new SpineRenderer(m_units);
+namespace {
+class SpineFboItem : public QQuickFramebufferObject {
+public:
+    explicit SpineFboItem(SpineViewport* viewport) : QQuickFramebufferObject(viewport), m_viewport(viewport) {
+        setMirrorVertically(true);
+    }
+
+    // The renderer syncs from the viewport (SpineRenderer::synchronize).
+    Renderer* createRenderer() const override { return m_viewport->createSpineRenderer(); }
+
+private:
+    SpineViewport* m_viewport;
+};
+}
+
+SpineViewport::SpineViewport(QQuickItem* parent)
+    : SpineViewportBase(parent), m_fbo(new SpineFboItem(this))
+{
+}
+
+void SpineViewport::requestFrame() {
+    m_fbo->update();
 }
 
-void SpineViewport::trigger(const QVariantList& commands) {
-    m_pendingCommands = commands;
-    update();
+QSGTextureProvider* SpineViewport::textureProvider() const {
+    return m_fbo->textureProvider();
 }
 
-QVariantList SpineViewport::takeCommands() {
-    QVariantList tmp = m_pendingCommands;
-    m_pendingCommands.clear();
-    return tmp;
+void SpineViewport::geometryChange(const QRectF& newGeometry, const QRectF& oldGeometry) {
+    SpineViewportBase::geometryChange(newGeometry, oldGeometry);
+    m_fbo->setSize(newGeometry.size());
 }
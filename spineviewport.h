@@ -1,22 +1,24 @@
 #pragma once
-#include <QQuickFramebufferObject>
-#include <QVariantList>
+#include "spineviewportbase.h"
 
-class SpineViewport : public QQuickFramebufferObject {
+class QQuickFramebufferObject;
+
+// Draws its units into an FBO that Qt Quick composites like any texture, so the last
+// frame is kept while nothing moves (idle skipping, layers) and the item can be a
+// texture provider (layer.enabled, ShaderEffect sources). The FBO item is a child that
+// fills the viewport.
+class SpineViewport : public SpineViewportBase {
     Q_OBJECT
-    Q_PROPERTY(QVariantList units READ units WRITE setUnits)
 public:
-    SpineViewport();
-    Renderer* createRenderer() const override;
+    explicit SpineViewport(QQuickItem* parent = nullptr);
 
-    QVariantList units() const { return m_units; }
-    void setUnits(const QVariantList& u) { m_units = u; update(); }
+    void requestFrame() override;
+    bool isTextureProvider() const override { return true; }
+    QSGTextureProvider* textureProvider() const override;
 
-    Q_INVOKABLE void trigger(const QVariantList& commands);
-    Q_INVOKABLE void tick() { update(); }
-    QVariantList takeCommands();
+protected:
+    void geometryChange(const QRectF& newGeometry, const QRectF& oldGeometry) override;
 
 private:
-    QVariantList m_units;
-    QVariantList m_pendingCommands;
+    QQuickFramebufferObject* m_fbo;
 };
@@ -0,0 +1,210 @@
+#include "spineviewportbase.h"
+#include "spinerenderer.h"
+#include "spineassetcache.h"
+#include "spinesimulation.h"
+
+#include <QDebug>
+#include <QStringList>
+#include <utility>
+
+SpineViewportBase::SpineViewportBase(QQuickItem* parent) : QQuickItem(parent) {}
+
+SpineRenderer* SpineViewportBase::createSpineRenderer() {
+    // A renderer made again (new window / scene graph) brings a new simulation whose
+    // pool instances all start idle.
+    if (m_layoutLocked) resetSpawnHandles();
+    lockLayout();
+    return new SpineRenderer(m_units, this);
+}
+
+// Render thread with the GUI thread blocked (createRenderer), or the GUI thread.
+void SpineViewportBase::lockLayout() {
+    m_layoutLocked = true;
+}
+
+void SpineViewportBase::setUnits(const QVariantList& u) {
+    // The simulation maps handles onto the configs it was created with; new handles
+    // would address other units.
+    if (m_layoutLocked) {
+        if (u != m_units) qWarning() << "[SpineViewport] units cannot change once the viewport has rendered; ignored";
+        return;
+    }
+    m_units = u;
+    m_unitHandles.clear();
+    for (int i = 0; i < m_units.size(); ++i) {
+        const QString name = m_units[i].toMap().value("name").toString();
+        if (!m_unitHandles.contains(name)) m_unitHandles.insert(name, i);
+    }
+    resetSpawnHandles();
+    requestFrame();
+}
+
+void SpineViewportBase::setSpawnPools(const QVariantList& p) {
+    // Instance handles and in-play state describe the running simulation's pools.
+    if (m_layoutLocked) {
+        if (p != m_spawnPools) qWarning() << "[SpineViewport] spawnPools cannot change once the viewport has rendered; ignored";
+        return;
+    }
+    m_spawnPools = p;
+    resetSpawnHandles();
+    requestFrame();
+}
+
+// Same layout as SpineSimulation's pool instances.
+void SpineViewportBase::resetSpawnHandles() {
+    m_poolIndex.clear();
+    m_idleHandles.clear();
+    m_poolOfInstance.clear();
+    int handle = int(m_units.size());
+    for (int p = 0; p < m_spawnPools.size(); ++p) {
+        const QVariantMap m = m_spawnPools[p].toMap();
+        const QString name = m.value("name").toString();
+        if (!m_poolIndex.contains(name)) m_poolIndex.insert(name, p);
+        else qWarning() << "[SpineViewport] duplicate spawn pool" << name << "is never used";
+
+        const int count = SpineSimulation::poolCapacity(m);
+        std::vector<int> idle;
+        idle.reserve(size_t(count));
+        // Taken from the back, so instances go out in order.
+        for (int i = count - 1; i >= 0; --i) idle.push_back(handle + i);
+        m_idleHandles.push_back(std::move(idle));
+        m_poolOfInstance.insert(m_poolOfInstance.end(), size_t(count), p);
+        handle += count;
+    }
+    m_inPlay.assign(m_poolOfInstance.size(), false);
+}
+
+int SpineViewportBase::spawnUnit(const QString& pool, double x, double y) {
+    const int p = m_poolIndex.value(pool, -1);
+    if (p < 0) {
+        qWarning() << "[SpineViewport] unknown spawn pool" << pool;
+        return -1;
+    }
+    std::vector<int>& idle = m_idleHandles[size_t(p)];
+    if (idle.empty()) {
+        qWarning() << "[SpineViewport] spawn pool" << pool << "exhausted; raise its count";
+        return -1;
+    }
+    const int unit = idle.back();
+    idle.pop_back();
+    m_inPlay[size_t(unit - m_units.size())] = true;
+
+    SpineCommand c;
+    c.op = SpineCommand::Spawn;
+    c.unit = unit;
+    c.x = float(x);
+    c.y = float(y);
+    post(c);
+    m_commands->wake();
+    requestFrame();
+    return unit;
+}
+
+void SpineViewportBase::despawnUnit(int unit) {
+    const int instance = unit - int(m_units.size());
+    if (instance < 0 || instance >= int(m_inPlay.size()) || !m_inPlay[size_t(instance)]) return;
+    m_inPlay[size_t(instance)] = false;
+    m_idleHandles[size_t(m_poolOfInstance[size_t(instance)])].push_back(unit);
+
+    SpineCommand c;
+    c.op = SpineCommand::Despawn;
+    c.unit = unit;
+    post(c);
+    m_commands->wake();
+    requestFrame();
+}
+
+int SpineViewportBase::animationHandle(const QString& animation) const {
+    return SpineCommand::animationHandle(animation.toUtf8());
+}
+
+void SpineViewportBase::setAnimation(int unit, int track, int animation, bool loop) {
+    SpineCommand c;
+    c.op = SpineCommand::SetAnimation;
+    c.unit = unit;
+    c.track = qint16(track);
+    c.animation = animation;
+    c.loop = loop;
+    post(c);
+    m_commands->wake();
+    requestFrame();
+}
+
+void SpineViewportBase::addAnimation(int unit, int track, int animation, bool loop, double delay) {
+    SpineCommand c;
+    c.op = SpineCommand::AddAnimation;
+    c.unit = unit;
+    c.track = qint16(track);
+    c.animation = animation;
+    c.loop = loop;
+    c.delay = float(delay);
+    post(c);
+    m_commands->wake();
+    requestFrame();
+}
+
+void SpineViewportBase::post(const SpineCommand& c) {
+    flushCommands();
+    if (!m_overflow.empty() || !m_commands->push(c)) m_overflow.push_back(c);
+}
+
+void SpineViewportBase::flushCommands() {
+    size_t sent = 0;
+    while (sent < m_overflow.size() && m_commands->push(m_overflow[sent])) ++sent;
+    m_overflow.erase(m_overflow.begin(), m_overflow.begin() + std::ptrdiff_t(sent));
+}
+
+void SpineViewportBase::trigger(const QVariantList& commands) {
+    for (auto cmd : commands) {
+        QVariantMap m = cmd.toMap();
+        const int unit = unitHandle(m.value("unit").toString());
+        if (unit < 0) continue;
+
+        const QStringList queue = m.value("queue").toStringList();
+        const int track = m.value("track", 0).toInt();
+        const bool loopLast = m.value("loopLast", true).toBool();
+
+        for (int i = 0; i < queue.size(); ++i) {
+            const bool isLast = (i == queue.size() - 1);
+            SpineCommand c;
+            c.op = i == 0 ? SpineCommand::SetAnimation : SpineCommand::AddAnimation;
+            c.unit = unit;
+            c.track = qint16(track);
+            c.animation = animationHandle(queue[i]);
+            c.loop = isLast ? loopLast : false;
+            post(c);
+        }
+    }
+    m_commands->wake();
+    requestFrame();
+}
+
+void SpineViewportBase::reportLoad(const QString& unit, int state, double progress) {
+    if (m_loadStates.value(unit, -1) != state) {
+        m_loadStates.insert(unit, state);
+        emit unitLoadStateChanged(unit, state);
+    }
+    emit unitLoadProgress(unit, progress);
+    // Keep frames coming while textures are still streaming in.
+    if (state != Ready && state != Failed) requestFrame();
+}
+
+void SpineViewportBase::setAnimating(bool a) {
+    if (m_animating == a) return;
+    m_animating = a;
+    emit animatingChanged();
+    if (a) requestFrame();
+}
+
+void SpineViewportBase::setPerfStats(const QVariantMap& stats) {
+    m_perfStats = stats;
+    emit perfStatsChanged();
+}
+
+QString SpineViewportBase::takeTraceRequest() {
+    return std::exchange(m_traceRequest, QString());
+}
+
+QVariantMap SpineViewportBase::assetCacheStats() const {
+    return SpineAssetCache::instance().statsMap();
+}
@@ -0,0 +1,195 @@
+#pragma once
+#include <QQuickItem>
+#include <QVariantList>
+#include <QHash>
+#include <memory>
+#include <vector>
+
+#include "spinecommand.h"
+
+class SpineRenderer;
+
+// Properties, commands and handle bookkeeping shared by SpineViewport (draws into an FBO
+// that Qt Quick composites) and SpineDirectViewport (draws into the scene graph's own
+// pass). Each subclass decides where the renderer it gets from createSpineRenderer()
+// draws and which item requestFrame() repaints.
+class SpineViewportBase : public QQuickItem {
+    Q_OBJECT
+    Q_PROPERTY(QVariantList units READ units WRITE setUnits)
+    Q_PROPERTY(QVariantList spawnPools READ spawnPools WRITE setSpawnPools)
+    Q_PROPERTY(int threads READ threads WRITE setThreads)
+    Q_PROPERTY(double simRate READ simRate WRITE setSimRate)
+    Q_PROPERTY(double uploadBudget READ uploadBudget WRITE setUploadBudget)
+    Q_PROPERTY(UpdateMode updateMode READ updateMode WRITE setUpdateMode)
+    Q_PROPERTY(bool animating READ animating NOTIFY animatingChanged)
+    Q_PROPERTY(OffscreenMode offscreenMode READ offscreenMode WRITE setOffscreenMode)
+    Q_PROPERTY(double offscreenInterval READ offscreenInterval WRITE setOffscreenInterval)
+    Q_PROPERTY(bool gpuSkinning READ gpuSkinning WRITE setGpuSkinning)
+    Q_PROPERTY(VertexFormat vertexFormat READ vertexFormat WRITE setVertexFormat)
+    Q_PROPERTY(QVariantList layers READ layers WRITE setLayers)
+    Q_PROPERTY(bool perfCounters READ perfCounters WRITE setPerfCounters)
+    Q_PROPERTY(int perfWindow READ perfWindow WRITE setPerfWindow)
+    Q_PROPERTY(QVariantMap perfStats READ perfStats NOTIFY perfStatsChanged)
+public:
+    // Mirrors SpineSkeletonAsset::State.
+    enum LoadState { Loading, Uploading, Ready, Failed };
+    Q_ENUM(LoadState)
+
+    // TimerDriven: repaints come from tick() (skipped while idle).
+    // Adaptive: the viewport repaints itself every frame while animating, then stops.
+    enum UpdateMode { TimerDriven, Adaptive };
+    Q_ENUM(UpdateMode)
+
+    // Mirrors SpineSimulation::OffscreenMode.
+    enum OffscreenMode { OffscreenFull, OffscreenReduced, OffscreenTimeOnly };
+    Q_ENUM(OffscreenMode)
+
+    // Mirrors SpineDrawList::VertexFormat.
+    enum VertexFormat { FloatVertex, PackedVertex, BatchColorVertex };
+    Q_ENUM(VertexFormat)
+
+    explicit SpineViewportBase(QQuickItem* parent = nullptr);
+
+    // Render thread with the GUI thread blocked: locks the layout and makes a renderer
+    // for it, with its own simulation.
+    SpineRenderer* createSpineRenderer();
+    // Asks for the next frame of the item that shows the units.
+    virtual void requestFrame() { requestFrame(); }
+
+    // Read when the renderer is created; later assignments are ignored with a warning,
+    // since unit handles index the configs the running simulation holds.
+    QVariantList units() const { return m_units; }
+    void setUnits(const QVariantList& u);
+
+    // Transient units: [{name, atlas, skel, scale, defaultAnim, clip, layer, count}]. Each
+    // pool keeps count skeleton instances, created once the asset has loaded, which
+    // spawnUnit() / despawnUnit() take in and out of play without loading or creating
+    // anything. Like units, read when the renderer is created and fixed afterwards.
+    QVariantList spawnPools() const { return m_spawnPools; }
+    void setSpawnPools(const QVariantList& p);
+
+    // Worker threads for the per-unit update phase, render thread included. 0 = one per core.
+    int threads() const { return m_threads; }
+    void setThreads(int n) { m_threads = n; requestFrame(); }
+
+    // Animation steps per second, independent of how often the item repaints.
+    double simRate() const { return m_simRate; }
+    void setSimRate(double hz) { m_simRate = hz; requestFrame(); }
+
+    // Milliseconds per frame the render thread may spend uploading atlas pages.
+    double uploadBudget() const { return m_uploadBudget; }
+    void setUploadBudget(double ms) { m_uploadBudget = ms; requestFrame(); }
+
+    UpdateMode updateMode() const { return m_updateMode; }
+    void setUpdateMode(UpdateMode m) { m_updateMode = m; requestFrame(); }
+
+    // False once every track has finished or is paused; frames are then skipped until a
+    // trigger, resize or load changes something.
+    bool animating() const { return m_animating; }
+
+    // How units outside the viewport are stepped; they are never tessellated.
+    OffscreenMode offscreenMode() const { return m_offscreenMode; }
+    void setOffscreenMode(OffscreenMode m) { m_offscreenMode = m; requestFrame(); }
+    // Seconds between pose refreshes of an off-screen unit (Reduced / TimeOnly).
+    double offscreenInterval() const { return m_offscreenInterval; }
+    void setOffscreenInterval(double s) { m_offscreenInterval = s; requestFrame(); }
+    // Skin weighted meshes in the vertex shader; deformed or clipped meshes stay on the CPU.
+    bool gpuSkinning() const { return m_gpuSkinning; }
+    void setGpuSkinning(bool on) { m_gpuSkinning = on; requestFrame(); }
+    // Vertex layout for A/B runs: 32-byte float, 20-byte packed, or 12-byte with
+    // per-batch colors. Takes effect on the next simulation step.
+    VertexFormat vertexFormat() const { return m_vertexFormat; }
+    void setVertexFormat(VertexFormat f) { m_vertexFormat = f; requestFrame(); }
+
+    // Cached render layers, back to front: [{name, rate}]. Units pick one with their
+    // "layer" config key; each layer is redrawn into its own texture when one of its units
+    // changed, at most rate times a second (0 = every change), and frames composite the
+    // textures. Units without a listed layer share the default layer "", drawn last unless
+    // listed. Empty = draw every unit straight into the item, as before.
+    QVariantList layers() const { return m_layers; }
+    void setLayers(const QVariantList& l) { m_layers = l; requestFrame(); }
+
+    // Per-frame CPU phase times, GPU time (timer queries), draw calls, vertices, indices,
+    // texture binds, blend switches, clipped slots and upload bytes over the last
+    // perfWindow drawn frames. perfStats is refreshed a few times a second while enabled.
+    bool perfCounters() const { return m_perfCounters; }
+    void setPerfCounters(bool on) { m_perfCounters = on; requestFrame(); }
+    int perfWindow() const { return m_perfWindow; }
+    void setPerfWindow(int frames) { m_perfWindow = frames; requestFrame(); }
+    QVariantMap perfStats() const { return m_perfStats; }
+    void setPerfStats(const QVariantMap& stats);
+    // Writes the window as Chrome trace JSON on the next frame; traceDumped reports it.
+    Q_INVOKABLE void dumpTrace(const QString& path) { m_traceRequest = path; requestFrame(); }
+    QString takeTraceRequest();
+    void setAnimating(bool a);
+
+    // Handles are resolved once and then reused for every command. unitHandle is -1 for
+    // an unknown unit; animation handles are valid for any name (a skeleton without
+    // that animation ignores the command).
+    Q_INVOKABLE int unitHandle(const QString& unit) const { return m_unitHandles.value(unit, -1); }
+
+    // Fixes units and spawnPools (and so every handle) for the simulation about to be
+    // created from them. createSpineRenderer() calls it.
+    void lockLayout();
+    Q_INVOKABLE int animationHandle(const QString& animation) const;
+
+    // Puts an idle instance of pool at (x, y) in its setup pose, playing its defaultAnim,
+    // and returns its unit handle for the calls below; -1 for an unknown pool or when
+    // every instance is in play. despawnUnit() hands the instance back.
+    Q_INVOKABLE int spawnUnit(const QString& pool, double x, double y);
+    Q_INVOKABLE void despawnUnit(int unit);
+
+    Q_INVOKABLE void setAnimation(int unit, int track, int animation, bool loop);
+    Q_INVOKABLE void addAnimation(int unit, int track, int animation, bool loop, double delay = 0.0);
+    // GUI thread. Commands reach the simulation in post order.
+    void post(const SpineCommand& c);
+    // Retries commands that did not fit in the queue; also called from synchronize.
+    void flushCommands();
+    std::shared_ptr<SpineCommandQueue> commandQueue() const { return m_commands; }
+
+    // Compatibility wrapper: [{unit, queue: [names], track, loopLast}] -> handle commands.
+    Q_INVOKABLE void trigger(const QVariantList& commands);
+    Q_INVOKABLE void tick() { if (m_animating) requestFrame(); }
+    // Process-wide asset cache counters: hits, misses, atlases, skeletons, residentBytes.
+    Q_INVOKABLE QVariantMap assetCacheStats() const;
+
+    Q_INVOKABLE int unitLoadState(const QString& unit) const { return m_loadStates.value(unit, Loading); }
+    void reportLoad(const QString& unit, int state, double progress);
+
+Q_SIGNALS:
+    void unitLoadStateChanged(const QString& unit, int state);
+    void unitLoadProgress(const QString& unit, double progress);
+    void animatingChanged();
+    void perfStatsChanged();
+    void traceDumped(const QString& path, bool ok);
+
+private:
+    QVariantList m_units;
+    QHash<QString, int> m_unitHandles;
+    bool m_layoutLocked = false;    // a simulation was created from units / spawnPools
+    // Pool instance handles follow the unit handles, pool by pool.
+    QVariantList m_spawnPools;
+    QHash<QString, int> m_poolIndex;
+    std::vector<std::vector<int>> m_idleHandles;   // per pool
+    std::vector<int> m_poolOfInstance;              // handle - m_units.size() -> pool
+    std::vector<bool> m_inPlay;                     // same index
+    std::shared_ptr<SpineCommandQueue> m_commands = std::make_shared<SpineCommandQueue>();
+    std::vector<SpineCommand> m_overflow;   // waiting for room in m_commands
+    int m_threads = 0;
+    double m_simRate = 60.0;
+    double m_uploadBudget = 4.0;
+    UpdateMode m_updateMode = TimerDriven;
+    bool m_animating = true;
+    OffscreenMode m_offscreenMode = OffscreenFull;
+    double m_offscreenInterval = 0.25;
+    bool m_gpuSkinning = false;
+    VertexFormat m_vertexFormat = FloatVertex;
+    QVariantList m_layers;
+    bool m_perfCounters = false;
+    int m_perfWindow = 120;
+    QVariantMap m_perfStats;
+    QString m_traceRequest;
+    QHash<QString, int> m_loadStates;
+
+    void resetSpawnHandles();
+};
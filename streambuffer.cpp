@@ -0,0 +1,143 @@
+#include "streambuffer.h"
+
+#include <QOpenGLContext>
+#include <QDebug>
+#include <cstring>
+
+StreamBuffer::StreamBuffer(QOpenGLBuffer::Type type, int capacityBytes)
+    : m_buf(type), m_capacity(capacityBytes) {}
+
+StreamBuffer::~StreamBuffer() {
+    destroy();
+}
+
+void StreamBuffer::create() {
+    if (m_buf.isCreated()) return;
+
+    m_gl = QOpenGLContext::currentContext()->extraFunctions();
+    m_buf.create();
+    m_buf.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    m_buf.bind();
+    m_buf.allocate(m_capacity);
+    m_buf.release();
+}
+
+void StreamBuffer::destroy() {
+    if (!m_buf.isCreated()) return;
+    clearFences();
+    m_buf.destroy();
+}
+
+void StreamBuffer::clearFences() {
+    for (auto& f : m_fences) m_gl->glDeleteSync(f.sync);
+    m_fences.clear();
+}
+
+void StreamBuffer::retireSignaled() {
+    while (!m_fences.empty()) {
+        const GLenum r = m_gl->glClientWaitSync(m_fences.front().sync, 0, 0);
+        if (r != GL_ALREADY_SIGNALED && r != GL_CONDITION_SATISFIED) break;
+        m_gl->glDeleteSync(m_fences.front().sync);
+        m_fences.pop_front();
+    }
+}
+
+void StreamBuffer::waitForRange(int begin, int end) {
+    // Fences complete in submission order, so waiting on the newest overlapping one
+    // also retires everything older.
+    int last = -1;
+    for (int i = 0; i < (int)m_fences.size(); ++i) {
+        if (m_fences[(size_t)i].overlaps(begin, end)) last = i;
+    }
+    if (last < 0) return;
+
+    const GLsync sync = m_fences[(size_t)last].sync;
+    const GLenum r = m_gl->glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (r != GL_ALREADY_SIGNALED && r != GL_CONDITION_SATISFIED) {
+        ++m_stats.fenceWaits;
+        m_gl->glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    }
+    for (int i = 0; i <= last; ++i) {
+        m_gl->glDeleteSync(m_fences.front().sync);
+        m_fences.pop_front();
+    }
+}
+
+int StreamBuffer::frameBytes() const {
+    return m_frameWrapped ? (m_capacity - m_frameBegin) + m_head : m_head - m_frameBegin;
+}
+
+void StreamBuffer::grow(int minBytes) {
+    int cap = m_capacity;
+    while (cap < minBytes) cap *= 2;
+    m_capacity = cap;
+
+    // Re-specifying storage orphans the old store; draws already issued keep using it.
+    clearFences();
+    m_buf.allocate(m_capacity);
+    m_head = 0;
+    m_frameBegin = 0;
+    m_frameWrapped = false;
+    ++m_stats.reallocations;
+    qWarning() << "[StreamBuffer] grew to" << m_capacity << "bytes";
+}
+
+int StreamBuffer::write(const void* data, int bytes, int align) {
+    if (bytes <= 0) return m_head;
+
+    int offset = (m_head + align - 1) / align * align;
+
+    if (m_frameWrapped && offset + bytes > m_frameBegin) {
+        grow(2 * (frameBytes() + bytes));
+        offset = 0;
+    } else if (offset + bytes > m_capacity) {
+        // Wrapping must not run into data this frame already wrote. If it would,
+        // the ring is too small for one frame: grow with headroom for frames in flight.
+        const int limit = m_frameWrapped ? 0 : m_frameBegin;
+        if (bytes > limit) {
+            grow(2 * (frameBytes() + bytes));
+        } else {
+            m_frameWrapped = true;
+            ++m_stats.wraps;
+        }
+        offset = 0;
+    }
+
+    waitForRange(offset, offset + bytes);
+
+    const GLenum target = GLenum(m_buf.type());
+    void* dst = nullptr;
+    if (m_useMap) {
+        dst = m_gl->glMapBufferRange(target, offset, bytes,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!dst) m_useMap = false;   // driver refused; stay on sub-data uploads
+    }
+    if (dst) {
+        std::memcpy(dst, data, (size_t)bytes);
+        m_gl->glUnmapBuffer(target);
+    } else {
+        m_buf.write(offset, data, bytes);
+    }
+
+    m_head = offset + bytes;
+    m_stats.bytesStreamed += (quint64)bytes;
+    return offset;
+}
+
+void StreamBuffer::endFrame() {
+    if (!m_buf.isCreated()) return;
+
+    retireSignaled();
+
+    if (frameBytes() > 0) {
+        Fence f;
+        f.sync = m_gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        f.begin = m_frameBegin;
+        f.end = m_frameWrapped ? m_capacity : m_head;
+        f.wrapEnd = m_frameWrapped ? m_head : 0;
+        m_fences.push_back(f);
+    }
+
+    m_frameBegin = m_head;
+    m_frameWrapped = false;
+}
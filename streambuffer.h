@@ -0,0 +1,67 @@
+#pragma once
+#include <QOpenGLBuffer>
+#include <QOpenGLExtraFunctions>
+#include <deque>
+
+// Persistent streaming buffer for per-frame geometry.
+// Writes land at increasing offsets inside one preallocated GL buffer; when the head
+// reaches the end it wraps to 0, waiting on the fence of whichever earlier frame still
+// owns that range. Storage is only re-specified when a single frame outgrows the ring.
+class StreamBuffer {
+public:
+    struct Stats {
+        quint64 bytesStreamed = 0;
+        int reallocations = 0;  // storage re-specified (initial allocation not counted)
+        int wraps = 0;
+        int fenceWaits = 0;     // wraps that had to block on the GPU
+    };
+
+    StreamBuffer(QOpenGLBuffer::Type type, int capacityBytes);
+    ~StreamBuffer();
+
+    // Needs a current context.
+    void create();
+    bool isCreated() const { return m_buf.isCreated(); }
+    void destroy();
+
+    void bind() { m_buf.bind(); }
+    void release() { m_buf.release(); }
+
+    // Copies bytes into the ring and returns the byte offset they landed at.
+    // The buffer must be bound.
+    int write(const void* data, int bytes, int align = 4);
+
+    // Fences everything written since the previous endFrame().
+    void endFrame();
+
+    int capacity() const { return m_capacity; }
+    // For indexed binding points (glBindBufferRange); the id survives a grow.
+    GLuint bufferId() const { return m_buf.bufferId(); }
+    const Stats& stats() const { return m_stats; }
+
+private:
+    // A frame covers [begin, end), plus [0, wrapEnd) when it wrapped.
+    struct Fence {
+        GLsync sync = nullptr;
+        int begin = 0;
+        int end = 0;
+        int wrapEnd = 0;
+        bool overlaps(int b, int e) const { return (begin < e && b < end) || b < wrapEnd; }
+    };
+
+    int frameBytes() const;
+    void grow(int minBytes);
+    void waitForRange(int begin, int end);
+    void retireSignaled();
+    void clearFences();
+
+    QOpenGLExtraFunctions* m_gl = nullptr;
+    QOpenGLBuffer m_buf;
+    int m_capacity = 0;
+    int m_head = 0;
+    int m_frameBegin = 0;
+    bool m_frameWrapped = false;
+    bool m_useMap = true;
+    std::deque<Fence> m_fences;
+    Stats m_stats;
+};
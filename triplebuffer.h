@@ -0,0 +1,36 @@
+#pragma once
+#include <atomic>
+
+// Lock-free single-producer / single-consumer triple buffer.
+// The producer always has a private slot to fill, the consumer always has a private
+// slot to read, and publish()/fetch() swap through the shared middle slot. Neither
+// side ever blocks; the consumer just sees the newest published value.
+template <class T>
+class TripleBuffer {
+public:
+    // Producer side.
+    T& writeBuffer() { return m_slots[m_write]; }
+    void publish() {
+        m_write = m_middle.exchange(m_write | kFresh, std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    // Consumer side. Returns true if a newer value was swapped in.
+    bool fetch() {
+        if (!(m_middle.load(std::memory_order_relaxed) & kFresh)) return false;
+        m_read = m_middle.exchange(m_read, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+    const T& readBuffer() const { return m_slots[m_read]; }
+
+    // Unsynchronized access, only while neither side is running.
+    T& slot(int i) { return m_slots[i]; }
+
+private:
+    static constexpr int kIndexMask = 0x3;
+    static constexpr int kFresh = 0x4;
+
+    T m_slots[3];
+    int m_write = 0;
+    int m_read = 1;
+    std::atomic<int> m_middle{2};
+};